@@ -2,23 +2,51 @@
 #define REV_AI_H_
 
 #include "board.h"
+#include "endgame.h"
+#include "mcts.h"
 #include "mtwister.h"
+#include "playout.h"
+#include "search.h"
+#include "timer.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
 
 typedef enum {
   AI_RANDOM,
   AI_GREEDY,
   AI_PURE_MCTS,
+  AI_UCT,
+  AI_ALPHA_BETA,
 } AIType;
 
 typedef struct AI AI;
-typedef int32_t Move(AI *ai, Turn turn, const ChildBoards *choices);
+// Returns the index of the chosen child of board. An AI that supports time
+// budgets returns by deadline (a ClockNow() time) unless it is NO_DEADLINE,
+// in which case it does its fixed amount of work.
+typedef int32_t Move(AI *ai, Turn turn, const Board *board,
+                     const ChildBoards *choices, double deadline);
+// Optional fast path: returns a square from the GenerateMoves() mask so the
+// caller only has to build the one child that is actually played.
+typedef int PickSquare(AI *ai, Turn turn, const Board *board, uint64_t moves,
+                       double deadline);
 typedef void ClearState(AI *ai);
+// Optional: called by PlayFrom() when a game the AI played ends.
+typedef void GameOver(AI *ai);
 
 struct AI {
   AIType type;
   Move *move;
+  PickSquare *pick;
   ClearState *clear;
+  GameOver *game_over;
   void *state;
+  // If set, positions with few enough empties are solved instead of being
+  // passed to move or pick. See AIEnableEndgameSolver().
+  EndgameSolver *endgame;
+  // Thinking time per move or per game. See AISetTimeBudget().
+  TimeBudget budget;
 };
 
 char *AIName(AI *ai) {
@@ -29,6 +57,10 @@ char *AIName(AI *ai) {
     return "AI_GREEDY";
   case AI_PURE_MCTS:
     return "AI_PURE_MCTS";
+  case AI_UCT:
+    return "AI_UCT";
+  case AI_ALPHA_BETA:
+    return "AI_ALPHA_BETA";
   default:
     return "AI_UNKNOWN";
   }
@@ -40,30 +72,104 @@ typedef struct Game {
   Board history[60];
   int length;
   GameResult result;
+  // Black pieces minus white pieces at the end.
+  int disc_difference;
+  // Thinking time of each side (indexed by Turn), in all and on its longest
+  // move. Not part of the record on disk.
+  double seconds[2];
+  double max_move_seconds[2];
 } Game;
 
+// Game records on disk: the length as a uint8, the disc difference as an
+// int8, then the boards of the history.
+bool GameWrite(FILE *file, const Game *game) {
+  int8_t header[2] = {(int8_t)game->length, (int8_t)game->disc_difference};
+  return fwrite(header, 1, 2, file) == 2 &&
+         fwrite(game->history, sizeof(Board), game->length, file) ==
+             (size_t)game->length;
+}
+
+// Returns false at the end of the file or on a truncated record.
+bool GameRead(FILE *file, Game *game) {
+  int8_t header[2];
+  if (fread(header, 1, 2, file) != 2 || header[0] < 0 || header[0] > 60) {
+    return false;
+  }
+  game->length = header[0];
+  game->disc_difference = header[1];
+  if (game->disc_difference > 0) {
+    game->result = GAME_BLACK_WON;
+  } else if (game->disc_difference < 0) {
+    game->result = GAME_WHITE_WON;
+  } else {
+    game->result = GAME_TIE;
+  }
+  return fread(game->history, sizeof(Board), game->length, file) ==
+         (size_t)game->length;
+}
+
 Game PlayFrom(AI *black_ai, AI *white_ai, const Board *start, Turn turn) {
   Board board = *start;
   ChildBoards children;
 
   Game game;
   game.length = 0;
+  game.seconds[BLACKS_TURN] = game.seconds[WHITES_TURN] = 0.0;
+  game.max_move_seconds[BLACKS_TURN] = game.max_move_seconds[WHITES_TURN] = 0.0;
+
+  // Time left on each side's game clock.
+  double remaining_seconds[2] = {black_ai->budget.game_seconds,
+                                 white_ai->budget.game_seconds};
 
   AI *ai = NULL;
   while (true) {
-    GenerateChildBoards(&board, turn, &children);
-    if (children.count == 0) {
+    uint64_t moves = GenerateMoves(&board, turn);
+    if (moves == 0) {
       turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
-      GenerateChildBoards(&board, turn, &children);
-      if (children.count == 0) {
+      moves = GenerateMoves(&board, turn);
+      if (moves == 0) {
         break;
       }
     }
 
     ai = (turn == BLACKS_TURN) ? black_ai : white_ai;
+    int num_empties = __builtin_popcountll(EmptySquares(&board));
+
+    double start_time = ClockNow();
+    double deadline = NO_DEADLINE;
+    if (TimeBudgetIsSet(&ai->budget)) {
+      deadline = start_time + TimeBudgetForMove(&ai->budget,
+                                                remaining_seconds[turn],
+                                                num_empties);
+    }
 
-    int32_t choice = ai->move(ai, turn, &children);
-    board = children.boards[choice];
+    int square = -1;
+    if (ai->endgame != NULL && num_empties <= ai->endgame->max_empties) {
+      // Under a budget the solver gets half of it, and the AI the rest if
+      // the solver runs out of time.
+      double solve_deadline = deadline;
+      if (deadline != NO_DEADLINE) {
+        solve_deadline = start_time + (deadline - start_time) / 2;
+      }
+      int score = 0;
+      square = EndgameBestSquare(ai->endgame, &board, turn, moves,
+                                 solve_deadline, &score);
+    }
+    if (square >= 0) {
+      MakeMove(&board, turn, square);
+    } else if (ai->pick != NULL) {
+      MakeMove(&board, turn, ai->pick(ai, turn, &board, moves, deadline));
+    } else {
+      GenerateChildBoards(&board, turn, &children);
+      int32_t choice = ai->move(ai, turn, &board, &children, deadline);
+      board = children.boards[choice];
+    }
+    double seconds = ClockNow() - start_time;
+    game.seconds[turn] += seconds;
+    if (seconds > game.max_move_seconds[turn]) {
+      game.max_move_seconds[turn] = seconds;
+    }
+    remaining_seconds[turn] -= seconds;
     turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
 
     game.history[game.length] = board;
@@ -73,6 +179,7 @@ Game PlayFrom(AI *black_ai, AI *white_ai, const Board *start, Turn turn) {
   int black_count = 0;
   int white_count = 0;
   CountPieces(&board, &black_count, &white_count);
+  game.disc_difference = black_count - white_count;
 
   if (black_count > white_count) {
     game.result = GAME_BLACK_WON;
@@ -82,6 +189,13 @@ Game PlayFrom(AI *black_ai, AI *white_ai, const Board *start, Turn turn) {
     game.result = GAME_TIE;
   }
 
+  if (black_ai->game_over != NULL) {
+    black_ai->game_over(black_ai);
+  }
+  if (white_ai != black_ai && white_ai->game_over != NULL) {
+    white_ai->game_over(white_ai);
+  }
+
   return game;
 }
 
@@ -96,36 +210,6 @@ typedef struct Tournament {
   int ties;
 } Tournament;
 
-Tournament PlayTournament(AI *black_ai, AI *white_ai, int num_games) {
-  Tournament tournament = {.black_wins = 0, .white_wins = 0, .ties = 0};
-
-  printf("%s vs. %s  Tournament  |  ", AIName(black_ai), AIName(white_ai));
-
-#pragma omp parallel for
-  for (int i = 0; i < num_games; ++i) {
-    Game game = Play(black_ai, white_ai);
-#pragma omp critical(update_tournament_win_counts)
-    {
-      tournament.black_wins += (game.result == GAME_BLACK_WON);
-      tournament.white_wins += (game.result == GAME_WHITE_WON);
-      tournament.ties += (game.result == GAME_TIE);
-    }
-  }
-  printf("(black/white/tie): (%d/%d/%d)", tournament.black_wins,
-         tournament.white_wins, tournament.ties);
-  if (tournament.black_wins > tournament.white_wins) {
-    printf("    Advantage %s (as BLACK) by: %d\n", AIName(black_ai),
-           tournament.black_wins - tournament.white_wins);
-  } else if (tournament.white_wins > tournament.black_wins) {
-    printf("    Advantage %s (as WHITE) by: %d\n", AIName(white_ai),
-           tournament.white_wins - tournament.black_wins);
-  } else {
-    printf("    TIED tournament!\n");
-  }
-
-  return tournament;
-}
-
 int FairArgMax(int *values, int size, MTRand *rng) {
   if (size <= 0) {
     return -1;
@@ -160,11 +244,19 @@ int FairArgMax(int *values, int size, MTRand *rng) {
   return arg_max;
 }
 
-int32_t AIRandomMove(AI *ai, Turn turn, const ChildBoards *choices) {
+int32_t AIRandomMove(AI *ai, Turn turn, const Board *board,
+                     const ChildBoards *choices, double deadline) {
   return (int32_t)genRandUniform((MTRand *)ai->state, choices->count);
 }
 
-int32_t AIGreedyMove(AI *ai, Turn turn, const ChildBoards *choices) {
+int AIRandomPick(AI *ai, Turn turn, const Board *board, uint64_t moves,
+                 double deadline) {
+  int count = __builtin_popcountll(moves);
+  return NthSetBit(moves, (int)genRandUniform((MTRand *)ai->state, count));
+}
+
+int32_t AIGreedyMove(AI *ai, Turn turn, const Board *board,
+                     const ChildBoards *choices, double deadline) {
   int pieces_count[MAX_NUM_CHILD_BOARDS];
   int black_count = 0;
   int white_count = 0;
@@ -178,48 +270,248 @@ int32_t AIGreedyMove(AI *ai, Turn turn, const ChildBoards *choices) {
 
 typedef struct AIStatePureMCTS {
   int num_playouts;
-  AI random;
+  PlayoutPolicy policy;
+  PlayoutRng playout_rng;
+  // Breaks ties between equally good moves.
+  MTRand rng;
 } AIStatePureMCTS;
 
-int32_t AIPureMCTS(AI *ai, Turn turn, const ChildBoards *choices) {
+int32_t AIPureMCTS(AI *ai, Turn turn, const Board *board,
+                   const ChildBoards *choices, double deadline) {
   AIStatePureMCTS *state = (AIStatePureMCTS *)ai->state;
-  int playouts_per_choice = state->num_playouts / choices->count;
-
-  GameResult winning_result =
-      (turn == BLACKS_TURN) ? GAME_BLACK_WON : GAME_WHITE_WON;
   Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
 
   int wins_count[MAX_NUM_CHILD_BOARDS];
   for (int i = 0; i < choices->count; ++i) {
     wins_count[i] = 0;
-    for (int p = 0; p < playouts_per_choice; ++p) {
-      Game game = PlayFrom(&state->random, &state->random, &choices->boards[i],
-                           next_turn);
-      if (game.result == winning_result) {
-        wins_count[i] += 2;
-      } else if (game.result == GAME_TIE) {
-        wins_count[i] += 1;
+  }
+
+  if (deadline == NO_DEADLINE) {
+    int playouts_per_choice = state->num_playouts / choices->count;
+    for (int i = 0; i < choices->count; ++i) {
+      wins_count[i] =
+          PlayoutBatch(&choices->boards[i], next_turn, playouts_per_choice,
+                       state->policy, &state->playout_rng);
+    }
+  } else {
+    // Rounds of one batch per choice, checking the clock once a round.
+    Deadline clock = DeadlineMake(deadline, 1);
+    do {
+      for (int i = 0; i < choices->count; ++i) {
+        wins_count[i] +=
+            PlayoutBatch(&choices->boards[i], next_turn, PLAYOUT_LANES,
+                         state->policy, &state->playout_rng);
       }
+    } while (!DeadlinePassed(&clock));
+  }
+
+  return FairArgMax(wins_count, choices->count, &state->rng);
+}
+
+typedef struct AIStateUCT {
+  int num_playouts;
+  int num_threads;
+  PlayoutPolicy policy;
+  // One playout generator per search thread.
+  PlayoutRng *rngs;
+  // Breaks ties between equally visited moves.
+  MTRand rng;
+  // See AIEnableUCTTreeReuse(). While has_tree, tree is rooted at the
+  // position after this AI's last move.
+  bool reuse;
+  bool ponder;
+  bool has_tree;
+  UCTTree tree;
+  // Root visits the last search started with, carried over by reuse and
+  // pondering.
+  uint32_t start_visits;
+  // Set while ponder_thread searches tree. stop_pondering asks it to return.
+  bool pondering;
+  bool stop_pondering;
+  pthread_t ponder_thread;
+} AIStateUCT;
+
+void *p_UCTPonder(void *arg) {
+  AIStateUCT *state = (AIStateUCT *)arg;
+#pragma omp parallel num_threads(state->num_threads)
+  {
+    PlayoutRng *rng = &state->rngs[omp_get_thread_num()];
+    while (!__atomic_load_n(&state->stop_pondering, __ATOMIC_RELAXED)) {
+      UCTIterate(&state->tree, rng);
     }
   }
+  return NULL;
+}
+
+void p_UCTStopPondering(AIStateUCT *state) {
+  if (state->pondering) {
+    __atomic_store_n(&state->stop_pondering, true, __ATOMIC_RELAXED);
+    pthread_join(state->ponder_thread, NULL);
+    state->pondering = false;
+  }
+}
 
-  return FairArgMax(wins_count, choices->count, (MTRand *)state->random.state);
+void p_UCTDropTree(AIStateUCT *state) {
+  p_UCTStopPondering(state);
+  if (state->has_tree) {
+    UCTTreeFree(&state->tree);
+    state->has_tree = false;
+  }
+}
+
+// Sets up tree for a search over choices, the children of board, reusing the
+// kept subtree for board if there is one.
+void p_UCTStartTree(AIStateUCT *state, const Board *board, Turn turn,
+                    const ChildBoards *choices, UCTTree *tree) {
+  uint32_t capacity = UCTArenaCapacity(state->num_playouts);
+  if (state->has_tree) {
+    int64_t index = UCTFindPosition(&state->tree, board, turn);
+    if (index >= 0) {
+      *tree = state->tree;
+      state->has_tree = false;
+      UCTTreeReroot(tree, index, capacity);
+      state->start_visits = tree->nodes[0].visits;
+      return;
+    }
+    p_UCTDropTree(state);
+  }
+  UCTTreeInit(tree, capacity);
+  tree->policy = state->policy;
+  UCTSetRoot(tree, board, turn, choices);
+  state->start_visits = 0;
+}
+
+int32_t AIUCTMove(AI *ai, Turn turn, const Board *board,
+                  const ChildBoards *choices, double deadline) {
+  AIStateUCT *state = (AIStateUCT *)ai->state;
+  if (!state->reuse && choices->count == 1) {
+    return 0;
+  }
+  p_UCTStopPondering(state);
+
+  // Without reuse, the tree is built per move: a tournament plays several
+  // games with the same AI at once.
+  UCTTree tree;
+  p_UCTStartTree(state, board, turn, choices, &tree);
+  int32_t choice = 0;
+  if (choices->count > 1) {
+    if (deadline == NO_DEADLINE) {
+      UCTSearch(&tree, state->num_playouts, state->num_threads, state->rngs);
+    } else {
+      UCTSearchUntil(&tree, deadline, state->num_threads, state->rngs);
+    }
+
+    int visits[MAX_NUM_CHILD_BOARDS];
+    for (int i = 0; i < choices->count; ++i) {
+      visits[i] = tree.nodes[1 + i].visits;
+    }
+    choice = FairArgMax(visits, choices->count, &state->rng);
+  }
+
+  // Keep the subtree under our move, unless the game is over or the endgame
+  // solver takes the next move.
+  const Board *chosen = &choices->boards[choice];
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int num_empties = __builtin_popcountll(EmptySquares(chosen));
+  bool keep = state->reuse &&
+              (GenerateMoves(chosen, next_turn) != 0 ||
+               GenerateMoves(chosen, turn) != 0) &&
+              (ai->endgame == NULL ||
+               num_empties - 1 > ai->endgame->max_empties);
+  if (!keep) {
+    UCTTreeFree(&tree);
+    return choice;
+  }
+  UCTTreeReroot(&tree, 1 + choice, UCTArenaCapacity(state->num_playouts));
+  state->tree = tree;
+  state->has_tree = true;
+  if (state->ponder) {
+    state->stop_pondering = false;
+    state->pondering =
+        pthread_create(&state->ponder_thread, NULL, p_UCTPonder, state) == 0;
+  }
+  return choice;
+}
+
+void AIUCTGameOver(AI *ai) { p_UCTDropTree((AIStateUCT *)ai->state); }
+
+// 2^18 entries of 24 bytes.
+#define ALPHA_BETA_TABLE_LOG_CAPACITY 18
+
+typedef struct AIStateAlphaBeta {
+  int depth;
+  // Threads searching each move together; see SearchBestChildParallel().
+  int num_threads;
+  // Pattern evaluation weights, owned by the caller, or NULL.
+  const EvalWeights *weights;
+  // Kept between moves. Games played at once with the same AI share it.
+  SearchTable table;
+} AIStateAlphaBeta;
+
+int32_t AIAlphaBetaMove(AI *ai, Turn turn, const Board *board,
+                        const ChildBoards *choices, double deadline) {
+  AIStateAlphaBeta *state = (AIStateAlphaBeta *)ai->state;
+  if (choices->count == 1) {
+    return 0;
+  }
+  Searcher searcher = {
+      .table = &state->table,
+      .weights = state->weights,
+      .nodes = 0,
+      .deadline = DeadlineMake(deadline, SEARCH_DEADLINE_CHECK_INTERVAL)};
+  int depth = (deadline == NO_DEADLINE) ? state->depth : SEARCH_MAX_DEPTH;
+  int score = 0;
+  return SearchBestChildParallel(&searcher, turn, choices, depth,
+                                 state->num_threads, &score);
 }
 
 void AIDefaultClear(AI *ai) {
   free(ai->state);
   ai->state = NULL;
+  if (ai->endgame != NULL) {
+    EndgameSolverFree(ai->endgame);
+    ai->endgame = NULL;
+  }
 }
 
-void AIClearPureMCTS(AI *ai) {
-  AIStatePureMCTS *state = (AIStatePureMCTS *)ai->state;
-  state->random.clear(&state->random);
+// Gives the AI a time limit per move (move_seconds), a clock for all of its
+// moves in a game (game_seconds), or both; zero means no limit of that kind.
+// PlayFrom() turns these into a deadline for each move. Under a budget,
+// pure MCTS and UCT play out until the deadline (num_playouts then only
+// sizes the UCT tree) and alpha-beta deepens until it, ignoring depth. The
+// random and greedy AIs are always instant.
+void AISetTimeBudget(AI *ai, double move_seconds, double game_seconds) {
+  ai->budget.move_seconds = move_seconds;
+  ai->budget.game_seconds = game_seconds;
+}
+
+// Makes the AI play perfectly once at most max_empties squares are empty,
+// maximizing the final disc difference if exact, otherwise just playing for
+// a win (or a draw). Works with any AI type.
+void AIEnableEndgameSolver(AI *ai, int max_empties, bool exact) {
+  if (ai->endgame != NULL) {
+    EndgameSolverFree(ai->endgame);
+  }
+  ai->endgame = EndgameSolverMake(max_empties, exact);
+}
+
+void AIClearUCT(AI *ai) {
+  AIStateUCT *state = (AIStateUCT *)ai->state;
+  p_UCTDropTree(state);
+  free(state->rngs);
+  AIDefaultClear(ai);
+}
+
+void AIClearAlphaBeta(AI *ai) {
+  AIStateAlphaBeta *state = (AIStateAlphaBeta *)ai->state;
+  SearchTableFree(&state->table);
   AIDefaultClear(ai);
 }
 
-AI p_AIMakeRandom(AIType type, Move *move) {
+AI p_AIMakeRandom(AIType type, Move *move, PickSquare *pick) {
   AI random = {.type = type,
                .move = move,
+               .pick = pick,
                .clear = AIDefaultClear,
                .state = malloc(sizeof(MTRand))};
   MTRand *rng = (MTRand *)random.state;
@@ -227,31 +519,212 @@ AI p_AIMakeRandom(AIType type, Move *move) {
   return random;
 }
 
-AI AIMakeRandom() { return p_AIMakeRandom(AI_RANDOM, AIRandomMove); }
+AI AIMakeRandom() {
+  return p_AIMakeRandom(AI_RANDOM, AIRandomMove, AIRandomPick);
+}
 
-AI AIMakeGreedy() { return p_AIMakeRandom(AI_GREEDY, AIGreedyMove); }
+AI AIMakeGreedy() { return p_AIMakeRandom(AI_GREEDY, AIGreedyMove, NULL); }
 
 AI AIMakePureMCTS(int num_playouts) {
   AI pure_mcts = {.type = AI_PURE_MCTS,
                   .move = AIPureMCTS,
-                  .clear = AIClearPureMCTS,
+                  .pick = NULL,
+                  .clear = AIDefaultClear,
                   .state = malloc(sizeof(AIStatePureMCTS))};
   AIStatePureMCTS *state = (AIStatePureMCTS *)pure_mcts.state;
   state->num_playouts = num_playouts;
-  state->random = AIMakeRandom();
+  state->policy = PLAYOUT_UNIFORM;
+  state->playout_rng = PlayoutRngSystemSeed();
+  state->rng = systemSeedRand();
   return pure_mcts;
 }
 
-AI AIMakeSameTypeAs(AI *ai) {
+// With num_threads > 1, each move is searched by that many threads sharing
+// one tree.
+AI AIMakeUCT(int num_playouts, int num_threads) {
+  AI uct = {.type = AI_UCT,
+            .move = AIUCTMove,
+            .pick = NULL,
+            .clear = AIClearUCT,
+            .state = malloc(sizeof(AIStateUCT))};
+  AIStateUCT *state = (AIStateUCT *)uct.state;
+  state->num_playouts = num_playouts;
+  state->num_threads = num_threads;
+  state->policy = PLAYOUT_UNIFORM;
+  state->rngs = (PlayoutRng *)malloc(num_threads * sizeof(PlayoutRng));
+  for (int i = 0; i < num_threads; ++i) {
+    state->rngs[i] = PlayoutRngSystemSeed();
+  }
+  state->rng = systemSeedRand();
+  state->reuse = false;
+  state->ponder = false;
+  state->has_tree = false;
+  state->start_visits = 0;
+  state->pondering = false;
+  state->stop_pondering = false;
+  return uct;
+}
+
+// Makes a UCT AI keep the subtree under the move it plays and continue from
+// the opponent's reply next move, instead of starting over. With ponder, a
+// background thread also keeps searching that subtree (on the opponent's
+// time) until the next move or the end of the game. The AI then remembers
+// its game, so it must only play one game at a time: use AIMakeSameTypeAs()
+// for each concurrent game.
+void AIEnableUCTTreeReuse(AI *ai, bool ponder) {
+  AIStateUCT *state = (AIStateUCT *)ai->state;
+  state->reuse = true;
+  state->ponder = ponder;
+  ai->game_over = AIUCTGameOver;
+}
+
+// Searches depth plies ahead, deepening one ply at a time. With
+// num_threads > 1, each move is searched by that many threads sharing one
+// transposition table.
+AI AIMakeAlphaBeta(int depth, int num_threads) {
+  AI alpha_beta = {.type = AI_ALPHA_BETA,
+                   .move = AIAlphaBetaMove,
+                   .pick = NULL,
+                   .clear = AIClearAlphaBeta,
+                   .state = malloc(sizeof(AIStateAlphaBeta))};
+  AIStateAlphaBeta *state = (AIStateAlphaBeta *)alpha_beta.state;
+  state->depth = depth;
+  state->num_threads = num_threads;
+  state->weights = NULL;
+  SearchTableInit(&state->table, ALPHA_BETA_TABLE_LOG_CAPACITY);
+  return alpha_beta;
+}
+
+// Makes an alpha-beta AI evaluate with pattern weights instead of the
+// built-in heuristic. The weights must outlive the AI.
+void AIAlphaBetaUseWeights(AI *ai, const EvalWeights *weights) {
+  AIStateAlphaBeta *state = (AIStateAlphaBeta *)ai->state;
+  state->weights = weights;
+  SearchTableFree(&state->table);
+  SearchTableInit(&state->table, ALPHA_BETA_TABLE_LOG_CAPACITY);
+}
+
+// Sets how a pure MCTS or UCT AI's playouts pick moves. Other AIs play no
+// random games and are left alone.
+void AISetPlayoutPolicy(AI *ai, PlayoutPolicy policy) {
+  if (ai->type == AI_PURE_MCTS) {
+    ((AIStatePureMCTS *)ai->state)->policy = policy;
+  } else if (ai->type == AI_UCT) {
+    ((AIStateUCT *)ai->state)->policy = policy;
+  }
+}
+
+AI p_AIMakeSameTypeAs(AI *ai) {
   if (ai->type == AI_RANDOM) {
     return AIMakeRandom();
   } else if (ai->type == AI_GREEDY) {
     return AIMakeGreedy();
   } else if (ai->type == AI_PURE_MCTS) {
     AIStatePureMCTS *state = (AIStatePureMCTS *)ai->state;
-    return AIMakePureMCTS(state->num_playouts);
+    AI pure_mcts = AIMakePureMCTS(state->num_playouts);
+    AISetPlayoutPolicy(&pure_mcts, state->policy);
+    return pure_mcts;
+  } else if (ai->type == AI_UCT) {
+    AIStateUCT *state = (AIStateUCT *)ai->state;
+    AI uct = AIMakeUCT(state->num_playouts, state->num_threads);
+    AISetPlayoutPolicy(&uct, state->policy);
+    if (state->reuse) {
+      AIEnableUCTTreeReuse(&uct, state->ponder);
+    }
+    return uct;
+  } else if (ai->type == AI_ALPHA_BETA) {
+    AIStateAlphaBeta *state = (AIStateAlphaBeta *)ai->state;
+    AI alpha_beta = AIMakeAlphaBeta(state->depth, state->num_threads);
+    AIAlphaBetaUseWeights(&alpha_beta, state->weights);
+    return alpha_beta;
   }
   return AIMakeRandom();
 }
 
+AI AIMakeSameTypeAs(AI *ai) {
+  AI copy = p_AIMakeSameTypeAs(ai);
+  copy.budget = ai->budget;
+  if (ai->endgame != NULL) {
+    AIEnableEndgameSolver(&copy, ai->endgame->max_empties, ai->endgame->exact);
+  }
+  return copy;
+}
+
+// Restarts ai's random choices from seed and forgets what it cached from
+// earlier games, so that its play from here on depends only on seed (and on
+// the clock, if it has a time budget).
+void AISeed(AI *ai, uint64_t seed) {
+  if (ai->type == AI_RANDOM || ai->type == AI_GREEDY) {
+    *(MTRand *)ai->state = seedRand(p_SplitMix64(&seed));
+  } else if (ai->type == AI_PURE_MCTS) {
+    AIStatePureMCTS *state = (AIStatePureMCTS *)ai->state;
+    state->playout_rng = PlayoutRngMake(p_SplitMix64(&seed));
+    state->rng = seedRand(p_SplitMix64(&seed));
+  } else if (ai->type == AI_UCT) {
+    AIStateUCT *state = (AIStateUCT *)ai->state;
+    p_UCTDropTree(state);
+    for (int i = 0; i < state->num_threads; ++i) {
+      state->rngs[i] = PlayoutRngMake(p_SplitMix64(&seed));
+    }
+    state->rng = seedRand(p_SplitMix64(&seed));
+  } else if (ai->type == AI_ALPHA_BETA) {
+    SearchTableClear(&((AIStateAlphaBeta *)ai->state)->table);
+  }
+  if (ai->endgame != NULL) {
+    SearchTableClear(&ai->endgame->table);
+  }
+}
+
+// Plays num_games games between black_ai and white_ai, spread over the
+// OpenMP threads. Each thread plays with its own copies of the AIs (see
+// AIMakeSameTypeAs()), and before every game both are seeded from seed and
+// the game number, so the results only depend on seed, not on the number of
+// threads or on which thread played which game. AIs with a time budget
+// still depend on the clock.
+Tournament PlayTournament(AI *black_ai, AI *white_ai, int num_games,
+                          uint64_t seed) {
+  printf("%s vs. %s  Tournament  |  ", AIName(black_ai), AIName(white_ai));
+
+  int black_wins = 0;
+  int white_wins = 0;
+  int ties = 0;
+#pragma omp parallel reduction(+ : black_wins, white_wins, ties)
+  {
+    AI black = AIMakeSameTypeAs(black_ai);
+    AI white = (white_ai == black_ai) ? black : AIMakeSameTypeAs(white_ai);
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < num_games; ++i) {
+      uint64_t game_seed = seed + (uint64_t)i * 0x9E3779B97F4A7C15;
+      AISeed(&black, p_SplitMix64(&game_seed));
+      if (white_ai != black_ai) {
+        AISeed(&white, p_SplitMix64(&game_seed));
+      }
+      Game game = Play(&black, &white);
+      black_wins += (game.result == GAME_BLACK_WON);
+      white_wins += (game.result == GAME_WHITE_WON);
+      ties += (game.result == GAME_TIE);
+    }
+    if (white_ai != black_ai) {
+      white.clear(&white);
+    }
+    black.clear(&black);
+  }
+  Tournament tournament = {
+      .black_wins = black_wins, .white_wins = white_wins, .ties = ties};
+
+  printf("(black/white/tie): (%d/%d/%d)", tournament.black_wins,
+         tournament.white_wins, tournament.ties);
+  if (tournament.black_wins > tournament.white_wins) {
+    printf("    Advantage %s (as BLACK) by: %d\n", AIName(black_ai),
+           tournament.black_wins - tournament.white_wins);
+  } else if (tournament.white_wins > tournament.black_wins) {
+    printf("    Advantage %s (as WHITE) by: %d\n", AIName(white_ai),
+           tournament.white_wins - tournament.black_wins);
+  } else {
+    printf("    TIED tournament!\n");
+  }
+
+  return tournament;
+}
+
 #endif // REV_AI_H_
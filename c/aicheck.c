@@ -0,0 +1,171 @@
+// AI regression check. Plays UCT with tree reuse, with and without
+// pondering, against random replies, and checks that each search starts
+// from the visits its kept subtree had for the opponent's reply. Then plays
+// each searching AI under a time limit per move and under a game clock, and
+// checks that no move and no game overran its budget.
+//
+// Usage: ./aicheck [num_games] [num_playouts]
+
+#include "ai.h"
+#include "board.h"
+#include "mtwister.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// How long the opponent thinks before replying, so a ponderer gets to run.
+#define AICHECK_REPLY_NSEC 5000000
+// Budgets for the time checks, and how far past a deadline a move may end:
+// searches only read the clock every so often, and PlayFrom() does some
+// work of its own after the AI returns.
+#define AICHECK_MOVE_SECONDS 0.02
+#define AICHECK_GAME_SECONDS 0.5
+#define AICHECK_SLACK_SECONDS 0.01
+
+// Returns the visits of the node a reusing UCT AI will continue from for
+// board with turn to move, or 0 if it will start over.
+uint32_t KeptVisits(AI *ai, const Board *board, Turn turn) {
+  AIStateUCT *state = (AIStateUCT *)ai->state;
+  if (!state->has_tree) {
+    return 0;
+  }
+  int64_t index = UCTFindPosition(&state->tree, board, turn);
+  if (index < 0) {
+    return 0;
+  }
+  return __atomic_load_n(&state->tree.nodes[index].visits, __ATOMIC_RELAXED);
+}
+
+// Plays num_games games of UCT (black) against random replies (white).
+// Without pondering the kept visits must carry over exactly; with it, a
+// search may only start with more. Returns false on a failed check.
+bool CheckUCTTreeReuse(bool ponder, int num_games, int num_playouts) {
+  AI uct = AIMakeUCT(num_playouts, 2);
+  AIEnableUCTTreeReuse(&uct, ponder);
+  MTRand rng = seedRand(1);
+
+  bool ok = true;
+  int num_moves = 0;
+  int num_reused = 0;
+  int num_pondered = 0;
+  for (int g = 0; g < num_games; ++g) {
+    AISeed(&uct, g + 1);
+    Board board = OpeningBoard();
+    Turn turn = BLACKS_TURN;
+    while (true) {
+      uint64_t moves = GenerateMoves(&board, turn);
+      if (moves == 0) {
+        turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+        moves = GenerateMoves(&board, turn);
+        if (moves == 0) {
+          break;
+        }
+      }
+
+      if (turn == WHITES_TURN) {
+        int count = __builtin_popcountll(moves);
+        int square = NthSetBit(moves, (int)genRandUniform(&rng, count));
+        MakeMove(&board, turn, square);
+        turn = BLACKS_TURN;
+        continue;
+      }
+
+      uint32_t kept = KeptVisits(&uct, &board, turn);
+      if (ponder) {
+        struct timespec reply = {.tv_sec = 0, .tv_nsec = AICHECK_REPLY_NSEC};
+        nanosleep(&reply, NULL);
+      }
+      ChildBoards children;
+      GenerateChildBoards(&board, turn, &children);
+      int32_t choice = uct.move(&uct, turn, &board, &children, NO_DEADLINE);
+      uint32_t start = ((AIStateUCT *)uct.state)->start_visits;
+      num_moves++;
+      num_reused += start > 0;
+      num_pondered += start > kept;
+      if (ponder ? start < kept : start != kept) {
+        printf("  game %d: search started with %u visits, kept %u\n", g,
+               start, kept);
+        ok = false;
+      }
+      board = children.boards[choice];
+      turn = WHITES_TURN;
+    }
+    uct.game_over(&uct);
+  }
+  uct.clear(&uct);
+
+  // Reuse that never happens, or pondering that never adds anything, is a
+  // failure too.
+  ok = ok && num_reused > 0 && (!ponder || num_pondered > 0);
+  printf("tree reuse%s: %d moves, %d continued a kept subtree, %d with "
+         "pondered visits  %s\n",
+         ponder ? " + ponder" : "", num_moves, num_reused, num_pondered,
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+// Plays num_games games of ai, as black and as white, against random under
+// budget. Returns false if a move took longer than the per-move limit or a
+// game longer than the game clock, give or take AICHECK_SLACK_SECONDS.
+bool CheckTimeBudget(AI *ai, double move_seconds, double game_seconds,
+                     int num_games) {
+  AISetTimeBudget(ai, move_seconds, game_seconds);
+  AI random = AIMakeRandom();
+  double max_move_seconds = 0.0;
+  double max_game_seconds = 0.0;
+  for (int g = 0; g < num_games; ++g) {
+    AISeed(ai, g + 1);
+    AISeed(&random, g + 1);
+    Turn side = (g % 2 == 0) ? BLACKS_TURN : WHITES_TURN;
+    Game game = (side == BLACKS_TURN) ? Play(ai, &random) : Play(&random, ai);
+    if (game.max_move_seconds[side] > max_move_seconds) {
+      max_move_seconds = game.max_move_seconds[side];
+    }
+    if (game.seconds[side] > max_game_seconds) {
+      max_game_seconds = game.seconds[side];
+    }
+  }
+  random.clear(&random);
+  AISetTimeBudget(ai, 0.0, 0.0);
+
+  bool ok = true;
+  if (move_seconds > 0.0) {
+    ok = ok && max_move_seconds <= move_seconds + AICHECK_SLACK_SECONDS;
+  }
+  if (game_seconds > 0.0) {
+    ok = ok && max_game_seconds <= game_seconds + AICHECK_SLACK_SECONDS;
+  }
+  printf("%-14s%-8s move %.3fs game %.3fs: longest move %.4fs, longest "
+         "game %.3fs  %s\n",
+         AIName(ai), (ai->endgame != NULL) ? " solver" : "", move_seconds,
+         game_seconds, max_move_seconds, max_game_seconds,
+         ok ? "ok" : "OVERRUN");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int num_games = (argc > 1) ? atoi(argv[1]) : 4;
+  int num_playouts = (argc > 2) ? atoi(argv[2]) : 2000;
+
+  bool ok = CheckUCTTreeReuse(false, num_games, num_playouts);
+  ok = CheckUCTTreeReuse(true, num_games, num_playouts) && ok;
+
+  AI ais[4] = {AIMakePureMCTS(num_playouts), AIMakeUCT(num_playouts, 1),
+               AIMakeAlphaBeta(SEARCH_MAX_DEPTH, 1),
+               AIMakeAlphaBeta(SEARCH_MAX_DEPTH, 1)};
+  // The solver shares the budget with the search it falls back on.
+  AIEnableEndgameSolver(&ais[3], 14, true);
+  for (int i = 0; i < 4; ++i) {
+    ok = CheckTimeBudget(&ais[i], AICHECK_MOVE_SECONDS, 0.0, num_games) && ok;
+    ok = CheckTimeBudget(&ais[i], 0.0, AICHECK_GAME_SECONDS, num_games) && ok;
+    ais[i].clear(&ais[i]);
+  }
+
+  if (!ok) {
+    printf("\naicheck FAILED\n");
+    return 1;
+  }
+  return 0;
+}
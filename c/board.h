@@ -2,21 +2,39 @@
 #define REV_BOARD_H_
 
 #include <immintrin.h>
+#include <x86intrin.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #define MAX_NUM_CHILD_BOARDS 60
+#define BOARD_BATCH_SIZE 32
+
+// Move generation and canonicalization use the AVX2 kernels when the compiler
+// targets AVX2. Define REV_SCALAR_MOVEGEN to build with the scalar reference
+// kernels.
+#if defined(__AVX2__) && !defined(REV_SCALAR_MOVEGEN)
+#define REV_AVX2_MOVEGEN
+#endif
 
 const uint64_t OPENING_BLACKS = 34628173824;
 const uint64_t OPENING_WHITES = 68853694464;
 const uint64_t LEFT_BIT = 0x8000000000000000;
+const uint64_t CORNERS = 0x8100000000000081;
 
 const uint64_t rcol = 72340172838076673ULL;
 const uint64_t lcol = 9259542123273814144ULL;
 const uint64_t not_rcol = 18374403900871474942Ull;
 const uint64_t not_lcol = 9187201950435737471ULL;
 
+// Shift amounts for four directions. Shifting by each one left and right
+// covers all eight. The masks drop pieces that wrapped around an edge.
+const int DIRECTION_SHIFTS[4] = {8, 1, 9, 7};
+const uint64_t LEFT_SHIFT_MASKS[4] = {0xFFFFFFFFFFFFFFFF, 0xFEFEFEFEFEFEFEFE,
+                                      0xFEFEFEFEFEFEFEFE, 0x7F7F7F7F7F7F7F7F};
+const uint64_t RIGHT_SHIFT_MASKS[4] = {0xFFFFFFFFFFFFFFFF, 0x7F7F7F7F7F7F7F7F,
+                                       0x7F7F7F7F7F7F7F7F, 0xFEFEFEFEFEFEFEFE};
+
 const char MARK_SIDE[] = "|";
 const char MARK_TOP_BOT[] = "-----------------";
 const char MARK_EMPTY[] = " ";
@@ -106,7 +124,63 @@ uint64_t RotatePiecesCCW_old_and_slow(uint64_t pieces) {
   return rotated;
 }
 
-uint64_t RotatePiecesCCW(uint64_t pieces) {
+uint64_t FlipPiecesTB_old_and_slow(uint64_t pieces) {
+  const uint64_t row = 255;
+  uint64_t flipped = 0;
+
+  for (int i = 0; i < 8; ++i) {
+    flipped <<= 8;
+
+    uint64_t mask = row << (i * 8);
+    mask = mask & pieces;
+    mask = mask >> (i * 8);
+    flipped ^= mask;
+  }
+
+  return flipped;
+}
+
+uint64_t FlipPiecesTB(uint64_t pieces) {
+  // Used calcperm.cpp to generate this. In hind-sight maybe this should have
+  // been obvious.
+  return __builtin_bswap64(pieces);
+}
+
+// Mirrors left to right (reverses the bits of each byte).
+uint64_t FlipPiecesLR(uint64_t pieces) {
+  uint64_t x = pieces;
+  x = ((x >> 1) & 0x5555555555555555) | ((x & 0x5555555555555555) << 1);
+  x = ((x >> 2) & 0x3333333333333333) | ((x & 0x3333333333333333) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0F) | ((x & 0x0F0F0F0F0F0F0F0F) << 4);
+  return x;
+}
+
+// Mirrors across the main diagonal (swaps rows and columns).
+uint64_t FlipPiecesDiag(uint64_t pieces) {
+  uint64_t x = pieces;
+  uint64_t t;
+  t = 0x0F0F0F0F00000000 & (x ^ (x << 28));
+  x ^= t ^ (t >> 28);
+  t = 0x3333000033330000 & (x ^ (x << 14));
+  x ^= t ^ (t >> 14);
+  t = 0x5500550055005500 & (x ^ (x << 7));
+  x ^= t ^ (t >> 7);
+  return x;
+}
+
+// Rotation kernels. PEXT/PDEP is fastest where it is implemented in
+// hardware, but it is microcoded (hundreds of cycles) on some CPUs and
+// missing on others, so one kernel is chosen at startup. See
+// p_SelectRotateKernel().
+typedef uint64_t RotatePieces(uint64_t pieces);
+
+typedef struct RotateKernel {
+  const char *name;
+  RotatePieces *ccw;
+  RotatePieces *cw;
+} RotateKernel;
+
+__attribute__((target("bmi2"))) uint64_t RotatePiecesCCWPext(uint64_t pieces) {
   // Used calcperm.cpp from:
   // http://programming.sirrida.de/index.php
   // to generate this code. What a cool program!!
@@ -121,7 +195,7 @@ uint64_t RotatePiecesCCW(uint64_t pieces) {
   return x;
 }
 
-uint64_t RotatePiecesCW(uint64_t pieces) {
+__attribute__((target("bmi2"))) uint64_t RotatePiecesCWPext(uint64_t pieces) {
   // Used calcperm.cpp from:
   // http://programming.sirrida.de/index.php
   // to generate this code. What a cool program!!
@@ -133,28 +207,123 @@ uint64_t RotatePiecesCW(uint64_t pieces) {
   return x;
 }
 
-uint64_t FlipPiecesTB_old_and_slow(uint64_t pieces) {
-  const uint64_t row = 255;
-  uint64_t flipped = 0;
+// A rotation is a diagonal mirror followed or preceded by a top/bottom
+// mirror, which are three delta swaps and a byte swap.
+uint64_t RotatePiecesCCWDeltaSwap(uint64_t pieces) {
+  return FlipPiecesTB(FlipPiecesDiag(pieces));
+}
 
-  for (int i = 0; i < 8; ++i) {
-    flipped <<= 8;
+uint64_t RotatePiecesCWDeltaSwap(uint64_t pieces) {
+  return FlipPiecesDiag(FlipPiecesTB(pieces));
+}
 
-    uint64_t mask = row << (i * 8);
-    mask = mask & pieces;
-    mask = mask >> (i * 8);
-    flipped ^= mask;
-  }
+// Lane k of the vector is shifted left by shifts[k], so the top bit of byte
+// j holds bit (8 * j + 7 - shifts[k]) of pieces. VPMOVMSKB collects those
+// into bits 8 * k + j, i.e. it transposes eight columns at a time.
+__attribute__((target("avx2"))) uint64_t p_GatherColumnsAVX2(uint64_t pieces,
+                                                             __m256i lo,
+                                                             __m256i hi) {
+  __m256i x = _mm256_set1_epi64x(pieces);
+  uint32_t low = _mm256_movemask_epi8(_mm256_sllv_epi64(x, lo));
+  uint32_t high = _mm256_movemask_epi8(_mm256_sllv_epi64(x, hi));
+  return low | ((uint64_t)high << 32);
+}
 
-  return flipped;
+__attribute__((target("avx2"))) uint64_t RotatePiecesCCWAVX2(uint64_t pieces) {
+  return p_GatherColumnsAVX2(pieces, _mm256_setr_epi64x(0, 1, 2, 3),
+                             _mm256_setr_epi64x(4, 5, 6, 7));
 }
 
-uint64_t FlipPiecesTB(uint64_t pieces) {
-  // Used calcperm.cpp to generate this. In hind-sight maybe this should have
-  // been obvious.
-  return __builtin_bswap64(pieces);
+__attribute__((target("avx2"))) uint64_t RotatePiecesCWAVX2(uint64_t pieces) {
+  return p_GatherColumnsAVX2(FlipPiecesTB(pieces),
+                             _mm256_setr_epi64x(7, 6, 5, 4),
+                             _mm256_setr_epi64x(3, 2, 1, 0));
 }
 
+// Source bit of each destination bit, for VPSHUFBITQMB.
+uint8_t ROTATE_CCW_SOURCE_BITS[64];
+uint8_t ROTATE_CW_SOURCE_BITS[64];
+
+// VPSHUFBITQMB gathers 64 arbitrary bits in one instruction.
+__attribute__((target("avx512f,avx512bw,avx512bitalg"))) uint64_t
+RotatePiecesCCWAVX512(uint64_t pieces) {
+  __m512i sources = _mm512_loadu_si512(ROTATE_CCW_SOURCE_BITS);
+  return _mm512_bitshuffle_epi64_mask(_mm512_set1_epi64(pieces), sources);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512bitalg"))) uint64_t
+RotatePiecesCWAVX512(uint64_t pieces) {
+  __m512i sources = _mm512_loadu_si512(ROTATE_CW_SOURCE_BITS);
+  return _mm512_bitshuffle_epi64_mask(_mm512_set1_epi64(pieces), sources);
+}
+
+RotateKernel ROTATE_KERNEL = {.name = "delta-swap",
+                              .ccw = RotatePiecesCCWDeltaSwap,
+                              .cw = RotatePiecesCWDeltaSwap};
+
+// Returns the average cycles per call of a dependent chain of rotations.
+// This is what exposes a microcoded PEXT.
+double p_ProbeRotateKernel(const RotateKernel *kernel) {
+  const int num_calls = 4096;
+  uint64_t x = OPENING_BLACKS;
+  uint64_t best = UINT64_MAX;
+  for (int trial = 0; trial < 3; ++trial) {
+    uint64_t t0 = __rdtsc();
+    for (int i = 0; i < num_calls; ++i) {
+      x = kernel->ccw(x) ^ i;
+    }
+    uint64_t t1 = __rdtsc();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+    }
+  }
+  // Keep the chain from being optimized away.
+  __asm__ volatile("" : : "r"(x));
+  return best / (double)num_calls;
+}
+
+// Picks the fastest rotation kernel this CPU supports.
+__attribute__((constructor)) void p_SelectRotateKernel() {
+  for (int i = 0; i < 64; ++i) {
+    ROTATE_CCW_SOURCE_BITS[i] = 8 * (i % 8) + 7 - i / 8;
+    ROTATE_CW_SOURCE_BITS[i] = 8 * (7 - i % 8) + i / 8;
+  }
+
+  RotateKernel candidates[4];
+  int num_candidates = 0;
+  candidates[num_candidates++] = ROTATE_KERNEL;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    candidates[num_candidates++] = (RotateKernel){
+        .name = "avx2", .ccw = RotatePiecesCCWAVX2, .cw = RotatePiecesCWAVX2};
+  }
+  if (__builtin_cpu_supports("bmi2")) {
+    candidates[num_candidates++] = (RotateKernel){
+        .name = "pext", .ccw = RotatePiecesCCWPext, .cw = RotatePiecesCWPext};
+  }
+  if (__builtin_cpu_supports("avx512bitalg") &&
+      __builtin_cpu_supports("avx512bw")) {
+    candidates[num_candidates++] = (RotateKernel){.name = "avx512",
+                                                  .ccw = RotatePiecesCCWAVX512,
+                                                  .cw = RotatePiecesCWAVX512};
+  }
+
+  double best_cycles = p_ProbeRotateKernel(&candidates[0]);
+  for (int i = 1; i < num_candidates; ++i) {
+    double cycles = p_ProbeRotateKernel(&candidates[i]);
+    if (cycles < best_cycles) {
+      best_cycles = cycles;
+      ROTATE_KERNEL = candidates[i];
+    }
+  }
+}
+
+const char *RotateKernelName() { return ROTATE_KERNEL.name; }
+
+uint64_t RotatePiecesCCW(uint64_t pieces) { return ROTATE_KERNEL.ccw(pieces); }
+
+uint64_t RotatePiecesCW(uint64_t pieces) { return ROTATE_KERNEL.cw(pieces); }
+
 void RotateBoardCCW(Board *board) {
   board->blacks = RotatePiecesCCW(board->blacks);
   board->whites = RotatePiecesCCW(board->whites);
@@ -165,7 +334,97 @@ void FlipBoardTB(Board *board) {
   board->whites = FlipPiecesTB(board->whites);
 }
 
+#ifdef REV_AVX2_MOVEGEN
+// Mirrors top to bottom (FlipPiecesTB) in each lane.
+__m256i p_FlipTB4(__m256i x) {
+  const __m256i bswap =
+      _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7,
+                       6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  return _mm256_shuffle_epi8(x, bswap);
+}
+
+// Mirrors left to right (reverses the bits of each row) in each lane.
+__m256i p_FlipLR4(__m256i x) {
+  const __m256i rev_lo =
+      _mm256_setr_epi8(0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15, 0,
+                       8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15);
+  const __m256i rev_hi = _mm256_slli_epi16(rev_lo, 4);
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i lo = _mm256_and_si256(x, nibble);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+  return _mm256_or_si256(_mm256_shuffle_epi8(rev_hi, lo),
+                         _mm256_shuffle_epi8(rev_lo, hi));
+}
+
+// Mirrors across the main diagonal (swaps rows and columns) in each lane.
+__m256i p_FlipDiag4(__m256i x) {
+  const __m256i k1 = _mm256_set1_epi64x(0x5500550055005500);
+  const __m256i k2 = _mm256_set1_epi64x(0x3333000033330000);
+  const __m256i k4 = _mm256_set1_epi64x(0x0F0F0F0F00000000);
+  __m256i t;
+  t = _mm256_and_si256(k4, _mm256_xor_si256(x, _mm256_slli_epi64(x, 28)));
+  x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_srli_epi64(t, 28)));
+  t = _mm256_and_si256(k2, _mm256_xor_si256(x, _mm256_slli_epi64(x, 14)));
+  x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_srli_epi64(t, 14)));
+  t = _mm256_and_si256(k1, _mm256_xor_si256(x, _mm256_slli_epi64(x, 7)));
+  x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_srli_epi64(t, 7)));
+  return x;
+}
+
+// Returns all-ones in the lanes where (b1, w1) < (b2, w2), comparing as
+// unsigned in the same order as MakeBoardCanonical().
+__m256i p_BoardsLess4(__m256i b1, __m256i w1, __m256i b2, __m256i w2) {
+  const __m256i sign = _mm256_set1_epi64x(LEFT_BIT);
+  __m256i b1s = _mm256_xor_si256(b1, sign);
+  __m256i b2s = _mm256_xor_si256(b2, sign);
+  __m256i w1s = _mm256_xor_si256(w1, sign);
+  __m256i w2s = _mm256_xor_si256(w2, sign);
+  __m256i w_less = _mm256_and_si256(_mm256_cmpeq_epi64(b1, b2),
+                                    _mm256_cmpgt_epi64(w2s, w1s));
+  return _mm256_or_si256(_mm256_cmpgt_epi64(b2s, b1s), w_less);
+}
+
+void p_KeepMin4(__m256i *best_b, __m256i *best_w, __m256i b, __m256i w) {
+  __m256i less = p_BoardsLess4(b, w, *best_b, *best_w);
+  *best_b = _mm256_blendv_epi8(*best_b, b, less);
+  *best_w = _mm256_blendv_epi8(*best_w, w, less);
+}
+
+// p_KeepMin4() that also keeps the symmetry each board came from.
+void p_KeepMinSymmetry4(__m256i *best_b, __m256i *best_w, __m256i *best_s,
+                        __m256i b, __m256i w, __m256i s) {
+  __m256i less = p_BoardsLess4(b, w, *best_b, *best_w);
+  *best_b = _mm256_blendv_epi8(*best_b, b, less);
+  *best_w = _mm256_blendv_epi8(*best_w, w, less);
+  *best_s = _mm256_blendv_epi8(*best_s, s, less);
+}
+
+#endif // REV_AVX2_MOVEGEN
+
 void MakeBoardCanonical(Board *board) {
+#ifdef REV_AVX2_MOVEGEN
+  // Holds two (blacks, whites) pairs per vector, so the eight symmetries
+  // take four vectors. These are regrouped into blacks and whites vectors
+  // and reduced to the minimum pair, halving the candidates each step.
+  uint64_t b = board->blacks;
+  uint64_t w = board->whites;
+  __m256i v0 = _mm256_setr_epi64x(b, w, FlipPiecesTB(b), FlipPiecesTB(w));
+  __m256i v1 = p_FlipLR4(v0);
+  __m256i v2 = p_FlipDiag4(v0);
+  __m256i v3 = p_FlipDiag4(v1);
+
+  __m256i blacks = _mm256_unpacklo_epi64(v0, v1);
+  __m256i whites = _mm256_unpackhi_epi64(v0, v1);
+  p_KeepMin4(&blacks, &whites, _mm256_unpacklo_epi64(v2, v3),
+             _mm256_unpackhi_epi64(v2, v3));
+  p_KeepMin4(&blacks, &whites, _mm256_permute4x64_epi64(blacks, 0x4E),
+             _mm256_permute4x64_epi64(whites, 0x4E));
+  p_KeepMin4(&blacks, &whites, _mm256_permute4x64_epi64(blacks, 0xB1),
+             _mm256_permute4x64_epi64(whites, 0xB1));
+
+  board->blacks = _mm256_extract_epi64(blacks, 0);
+  board->whites = _mm256_extract_epi64(whites, 0);
+#else
   uint64_t blacks_[8];
   uint64_t whites_[8];
 
@@ -196,20 +455,86 @@ void MakeBoardCanonical(Board *board) {
 
   board->blacks = blacks_[min_index];
   board->whites = whites_[min_index];
+#endif
 }
 
-void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
-                           bool canonical) {
-  children->count = 0;
+// The eight symmetries of the board, numbered by the mirrors they apply:
+// top/bottom if bit 1 is set and left/right if bit 0 is, then the main
+// diagonal if bit 2 is.
+uint64_t SymmetricPieces(uint64_t pieces, int symmetry) {
+  if (symmetry & 2) {
+    pieces = FlipPiecesTB(pieces);
+  }
+  if (symmetry & 1) {
+    pieces = FlipPiecesLR(pieces);
+  }
+  if (symmetry & 4) {
+    pieces = FlipPiecesDiag(pieces);
+  }
+  return pieces;
+}
+
+Board SymmetricBoard(const Board *board, int symmetry) {
+  Board image = {.blacks = SymmetricPieces(board->blacks, symmetry),
+                 .whites = SymmetricPieces(board->whites, symmetry)};
+  return image;
+}
+
+// MakeBoardCanonical() that also returns the symmetry (see
+// SymmetricPieces()) taking the board to its canonical form. When several
+// do, any of them may be returned.
+int MakeBoardCanonicalSymmetry(Board *board) {
+#ifdef REV_AVX2_MOVEGEN
+  // As in MakeBoardCanonical(), with the symmetry of each candidate carried
+  // along in a third vector.
+  uint64_t b = board->blacks;
+  uint64_t w = board->whites;
+  __m256i v0 = _mm256_setr_epi64x(b, w, FlipPiecesTB(b), FlipPiecesTB(w));
+  __m256i v1 = p_FlipLR4(v0);
+  __m256i v2 = p_FlipDiag4(v0);
+  __m256i v3 = p_FlipDiag4(v1);
+
+  __m256i blacks = _mm256_unpacklo_epi64(v0, v1);
+  __m256i whites = _mm256_unpackhi_epi64(v0, v1);
+  __m256i symmetries = _mm256_setr_epi64x(0, 1, 2, 3);
+  p_KeepMinSymmetry4(&blacks, &whites, &symmetries,
+                     _mm256_unpacklo_epi64(v2, v3),
+                     _mm256_unpackhi_epi64(v2, v3),
+                     _mm256_setr_epi64x(4, 5, 6, 7));
+  p_KeepMinSymmetry4(&blacks, &whites, &symmetries,
+                     _mm256_permute4x64_epi64(blacks, 0x4E),
+                     _mm256_permute4x64_epi64(whites, 0x4E),
+                     _mm256_permute4x64_epi64(symmetries, 0x4E));
+  p_KeepMinSymmetry4(&blacks, &whites, &symmetries,
+                     _mm256_permute4x64_epi64(blacks, 0xB1),
+                     _mm256_permute4x64_epi64(whites, 0xB1),
+                     _mm256_permute4x64_epi64(symmetries, 0xB1));
+
+  board->blacks = _mm256_extract_epi64(blacks, 0);
+  board->whites = _mm256_extract_epi64(whites, 0);
+  return _mm256_extract_epi64(symmetries, 0);
+#else
+  Board best = *board;
+  int best_symmetry = 0;
+  for (int i = 1; i < 8; ++i) {
+    Board image = SymmetricBoard(board, i);
+    if (image.blacks < best.blacks ||
+        (image.blacks == best.blacks && image.whites < best.whites)) {
+      best = image;
+      best_symmetry = i;
+    }
+  }
+  *board = best;
+  return best_symmetry;
+#endif
+}
 
+uint64_t GenerateMovesScalar(const Board *board, Turn turn) {
   uint64_t up_moves, dn_moves, lf_moves, rt_moves;
   uint64_t ur_moves, ul_moves, dr_moves, dl_moves;
   uint64_t moves;
 
   uint64_t e, w, b;
-  uint64_t mv, flip, tmp;
-
-  Board *child;
 
   e = ~(board->blacks | board->whites);
   b = board->blacks;
@@ -252,7 +577,7 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_rcol & (c2_run << 1);
     c1_mv = not_rcol & (c1_mv << 1);
-    lf_moves = lf_moves | c2_run & c1_mv;
+    lf_moves = lf_moves | (c2_run & c1_mv);
   }
   lf_moves = lf_moves & e;
 
@@ -263,7 +588,7 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_lcol & (c2_run >> 1);
     c1_mv = not_lcol & (c1_mv >> 1);
-    rt_moves = rt_moves | c2_run & c1_mv;
+    rt_moves = rt_moves | (c2_run & c1_mv);
   }
   rt_moves = rt_moves & e;
 
@@ -274,7 +599,7 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_lcol & (c2_run << 7);
     c1_mv = not_lcol & (c1_mv << 7);
-    ur_moves = ur_moves | c2_run & c1_mv;
+    ur_moves = ur_moves | (c2_run & c1_mv);
   }
   ur_moves = ur_moves & e;
 
@@ -285,7 +610,7 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_rcol & (c2_run << 9);
     c1_mv = not_rcol & (c1_mv << 9);
-    ul_moves = ul_moves | c2_run & c1_mv;
+    ul_moves = ul_moves | (c2_run & c1_mv);
   }
   ul_moves = ul_moves & e;
 
@@ -296,7 +621,7 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_lcol & (c2_run >> 9);
     c1_mv = not_lcol & (c1_mv >> 9);
-    dr_moves = dr_moves | c2_run & c1_mv;
+    dr_moves = dr_moves | (c2_run & c1_mv);
   }
   dr_moves = dr_moves & e;
 
@@ -307,102 +632,241 @@ void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
   for (int i = 1; i < 7; ++i) {
     c2_run = c2_run & not_rcol & (c2_run >> 7);
     c1_mv = not_rcol & (c1_mv >> 7);
-    dl_moves = dl_moves | c2_run & c1_mv;
+    dl_moves = dl_moves | (c2_run & c1_mv);
   }
   dl_moves = dl_moves & e;
 
   moves = up_moves | dn_moves | lf_moves | rt_moves | ur_moves | ul_moves |
           dr_moves | dl_moves;
 
-  if (moves == 0) {
-    return;
+  return moves;
+}
+
+uint64_t p_ShiftPieces(uint64_t pieces, int shift) {
+  return (shift > 0) ? (pieces << shift) : (pieces >> -shift);
+}
+
+// Returns the c2 pieces bracketed between mv and a c1 piece along one
+// direction. The mask removes pieces that wrapped around a board edge.
+uint64_t p_FlipsInDirection(uint64_t mv, uint64_t c1, uint64_t c2, int shift,
+                            uint64_t mask) {
+  uint64_t flip = 0;
+  uint64_t tmp = mask & p_ShiftPieces(mv, shift);
+  while (tmp & c2) {
+    flip = flip | tmp;
+    tmp = mask & p_ShiftPieces(tmp, shift);
   }
+  return (tmp & c1) ? flip : 0;
+}
 
-  for (int i = 0; i < 64; ++i) {
-    mv = (1ULL << i);
-    if ((moves & mv) == 0) {
-      continue;
-    }
+uint64_t ComputeFlipsScalar(const Board *board, Turn turn, int square) {
+  uint64_t c1 = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  uint64_t c2 = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+  uint64_t mv = 1ULL << square;
 
-    flip = mv;
+  return p_FlipsInDirection(mv, c1, c2, -8, ~0ULL) |
+         p_FlipsInDirection(mv, c1, c2, 8, ~0ULL) |
+         p_FlipsInDirection(mv, c1, c2, -1, not_lcol) |
+         p_FlipsInDirection(mv, c1, c2, 1, not_rcol) |
+         p_FlipsInDirection(mv, c1, c2, -7, not_rcol) |
+         p_FlipsInDirection(mv, c1, c2, -9, not_lcol) |
+         p_FlipsInDirection(mv, c1, c2, 9, not_rcol) |
+         p_FlipsInDirection(mv, c1, c2, 7, not_lcol);
+}
 
-    if (mv & up_moves) {
-      tmp = mv >> 8;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp >> 8;
-      }
-    }
-    if (mv & dn_moves) {
-      tmp = mv << 8;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp << 8;
-      }
-    }
-    if (mv & lf_moves) {
-      tmp = mv >> 1;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp >> 1;
-      }
-    }
-    if (mv & rt_moves) {
-      tmp = mv << 1;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp << 1;
-      }
-    }
-    if (mv & ur_moves) {
-      tmp = mv >> 7;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp >> 7;
-      }
-    }
-    if (mv & ul_moves) {
-      tmp = mv >> 9;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp >> 9;
-      }
-    }
-    if (mv & dr_moves) {
-      tmp = mv << 9;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp << 9;
-      }
-    }
-    if (mv & dl_moves) {
-      tmp = mv << 7;
-      while (tmp & c2) {
-        flip = flip | tmp;
-        tmp = tmp << 7;
-      }
-    }
+#ifdef REV_AVX2_MOVEGEN
+// The AVX2 kernels hold four directions per vector (shifts of 8, 1, 9 and 7)
+// and run them once shifting left and once shifting right. Each direction is
+// a Kogge-Stone occluded fill: three doubling steps cover the longest
+// possible run of six opponent pieces. The masks drop pieces that wrapped
+// around the left or right edge.
+__m256i p_DirectionShifts() { return _mm256_set_epi64x(7, 9, 1, 8); }
 
-    child = &children->boards[children->count];
+__m256i p_LeftShiftMasks() {
+  return _mm256_set_epi64x(not_lcol, not_rcol, not_rcol, ~0ULL);
+}
 
-    if (turn == BLACKS_TURN) {
-      child->blacks = board->blacks | flip;
-      child->whites = board->whites & ~flip;
-    } else {
-      child->blacks = board->blacks & ~flip;
-      child->whites = board->whites | flip;
+__m256i p_RightShiftMasks() {
+  return _mm256_set_epi64x(not_rcol, not_lcol, not_lcol, ~0ULL);
+}
+
+uint64_t p_OrLanes(__m256i x) {
+  __m128i y = _mm_or_si128(_mm256_castsi256_si128(x),
+                           _mm256_extracti128_si256(x, 1));
+  return _mm_cvtsi128_si64(y) | _mm_extract_epi64(y, 1);
+}
+
+// Kogge-Stone occluded fill of gen through pro, shifting left by s.
+__m256i p_FillLeft(__m256i gen, __m256i pro, __m256i s) {
+  __m256i t;
+  for (int i = 0; i < 3; ++i) {
+    t = _mm256_sllv_epi64(gen, s);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, t));
+    pro = _mm256_and_si256(pro, _mm256_sllv_epi64(pro, s));
+    s = _mm256_add_epi64(s, s);
+  }
+  return gen;
+}
+
+// Kogge-Stone occluded fill of gen through pro, shifting right by s.
+__m256i p_FillRight(__m256i gen, __m256i pro, __m256i s) {
+  __m256i t;
+  for (int i = 0; i < 3; ++i) {
+    t = _mm256_srlv_epi64(gen, s);
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, t));
+    pro = _mm256_and_si256(pro, _mm256_srlv_epi64(pro, s));
+    s = _mm256_add_epi64(s, s);
+  }
+  return gen;
+}
+
+uint64_t GenerateMovesAVX2(const Board *board, Turn turn) {
+  uint64_t c1 = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  uint64_t c2 = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+  uint64_t e = ~(board->blacks | board->whites);
+
+  __m256i s = p_DirectionShifts();
+  __m256i lmask = p_LeftShiftMasks();
+  __m256i rmask = p_RightShiftMasks();
+  __m256i own = _mm256_set1_epi64x(c1);
+  __m256i opp = _mm256_set1_epi64x(c2);
+
+  __m256i lgen = p_FillLeft(own, _mm256_and_si256(opp, lmask), s);
+  __m256i rgen = p_FillRight(own, _mm256_and_si256(opp, rmask), s);
+
+  // Step once past the runs of opponent pieces to find the empty squares.
+  lgen = _mm256_sllv_epi64(_mm256_xor_si256(lgen, own), s);
+  rgen = _mm256_srlv_epi64(_mm256_xor_si256(rgen, own), s);
+  lgen = _mm256_and_si256(lmask, lgen);
+  rgen = _mm256_and_si256(rmask, rgen);
+
+  return e & p_OrLanes(_mm256_or_si256(lgen, rgen));
+}
+
+uint64_t ComputeFlipsAVX2(const Board *board, Turn turn, int square) {
+  uint64_t c1 = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  uint64_t c2 = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+
+  __m256i s = p_DirectionShifts();
+  __m256i lmask = p_LeftShiftMasks();
+  __m256i rmask = p_RightShiftMasks();
+  __m256i own = _mm256_set1_epi64x(c1);
+  __m256i opp = _mm256_set1_epi64x(c2);
+  __m256i mv = _mm256_set1_epi64x(1ULL << square);
+
+  __m256i lgen = p_FillLeft(mv, _mm256_and_si256(opp, lmask), s);
+  __m256i rgen = p_FillRight(mv, _mm256_and_si256(opp, rmask), s);
+
+  // A run only flips if the square just past it holds one of our pieces.
+  __m256i zero = _mm256_setzero_si256();
+  __m256i lend = _mm256_and_si256(lmask, _mm256_sllv_epi64(lgen, s));
+  __m256i rend = _mm256_and_si256(rmask, _mm256_srlv_epi64(rgen, s));
+  lend = _mm256_cmpeq_epi64(_mm256_and_si256(own, lend), zero);
+  rend = _mm256_cmpeq_epi64(_mm256_and_si256(own, rend), zero);
+  lgen = _mm256_andnot_si256(lend, _mm256_xor_si256(lgen, mv));
+  rgen = _mm256_andnot_si256(rend, _mm256_xor_si256(rgen, mv));
+
+  return p_OrLanes(_mm256_or_si256(lgen, rgen));
+}
+#endif // REV_AVX2_MOVEGEN
+
+// Returns a bitmask of turn's legal moves.
+uint64_t GenerateMoves(const Board *board, Turn turn) {
+#ifdef REV_AVX2_MOVEGEN
+  return GenerateMovesAVX2(board, turn);
+#else
+  return GenerateMovesScalar(board, turn);
+#endif
+}
+
+// Returns the opponent pieces flipped by playing at square (0-63, where
+// square i is the bit 1 << i). Does not include the played square itself.
+uint64_t ComputeFlips(const Board *board, Turn turn, int square) {
+#ifdef REV_AVX2_MOVEGEN
+  return ComputeFlipsAVX2(board, turn, square);
+#else
+  return ComputeFlipsScalar(board, turn, square);
+#endif
+}
+
+uint64_t EmptySquares(const Board *board) {
+  return ~(board->blacks | board->whites);
+}
+
+// Places a piece on square and flips flips, which must be
+// ComputeFlips(board, turn, square).
+void ApplyMove(Board *board, Turn turn, int square, uint64_t flips) {
+  uint64_t flip = flips | (1ULL << square);
+
+  if (turn == BLACKS_TURN) {
+    board->blacks = board->blacks | flip;
+    board->whites = board->whites & ~flip;
+  } else {
+    board->blacks = board->blacks & ~flip;
+    board->whites = board->whites | flip;
+  }
+}
+
+// Plays turn's piece at square, which must be set in GenerateMoves().
+void MakeMove(Board *board, Turn turn, int square) {
+  ApplyMove(board, turn, square, ComputeFlips(board, turn, square));
+}
+
+// Returns the square of the n-th (0-based) set bit of moves, counting up from
+// square 0. This matches the order of GenerateChildBoards().
+int NthSetBit(uint64_t moves, int n) {
+  for (int i = 0; i < n; ++i) {
+    moves = moves & (moves - 1);
+  }
+  return __builtin_ctzll(moves);
+}
+
+// A small open-addressing set used to drop symmetric duplicates among the
+// children of one board. It stores indices into the caller's array of
+// boards. Since a board has at most MAX_NUM_CHILD_BOARDS children, 64 slots
+// are always enough.
+typedef struct ChildSet {
+  uint64_t used;
+  uint8_t indices[64];
+} ChildSet;
+
+// Adds boards[index] unless an equal board is already in the set. Returns
+// whether it was added.
+bool p_ChildSetAdd(ChildSet *set, Board *boards, int index) {
+  Board *board = &boards[index];
+  uint64_t x = (board->blacks ^ (board->whites * 0x9E3779B97F4A7C15));
+  int slot = (x * 0xBF58476D1CE4E5B9) >> 58;
+  while (set->used & (1ULL << slot)) {
+    if (BoardsEqual(board, &boards[set->indices[slot]])) {
+      return false;
     }
+    slot = (slot + 1) & 63;
+  }
+  set->used |= 1ULL << slot;
+  set->indices[slot] = index;
+  return true;
+}
+
+void m_GenerateChildBoards(Board *board, Turn turn, ChildBoards *children,
+                           bool canonical) {
+  children->count = 0;
+
+  uint64_t moves = GenerateMoves(board, turn);
+
+  Board *child;
+  ChildSet siblings = {.used = 0};
+
+  while (moves != 0) {
+    int square = __builtin_ctzll(moves);
+    moves = moves & (moves - 1);
+
+    child = &children->boards[children->count];
+    *child = *board;
+    MakeMove(child, turn, square);
 
     if (canonical) {
       MakeBoardCanonical(child);
-      bool already_present = false;
-      for (int j = 0; j < children->count; ++j) {
-        if (BoardsEqual(child, &children->boards[j])) {
-          already_present = true;
-          break;
-        }
-      }
-      if (already_present) {
+      if (!p_ChildSetAdd(&siblings, children->boards, children->count)) {
         continue;
       }
     }
@@ -420,4 +884,220 @@ void GenerateCanonicalChildBoards(Board *board, Turn turn,
   m_GenerateChildBoards(board, turn, children, true);
 }
 
+// Batched kernels. These work on runs of boards (e.g. a slice of a
+// BoardBucket) so that whole BFS frontiers can be expanded without a call per
+// board. The AVX2 versions hold the same bitboard of four different boards
+// in one vector.
+#ifdef REV_AVX2_MOVEGEN
+// Transposes four boards into a vector of blacks and a vector of whites.
+void p_LoadBoards4(const Board *boards, __m256i *blacks, __m256i *whites) {
+  __m256i lo = _mm256_loadu_si256((const __m256i *)boards);
+  __m256i hi = _mm256_loadu_si256((const __m256i *)(boards + 2));
+  *blacks = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(lo, hi), 0xD8);
+  *whites = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(lo, hi), 0xD8);
+}
+
+void p_StoreBoards4(Board *boards, __m256i blacks, __m256i whites) {
+  blacks = _mm256_permute4x64_epi64(blacks, 0xD8);
+  whites = _mm256_permute4x64_epi64(whites, 0xD8);
+  _mm256_storeu_si256((__m256i *)boards,
+                      _mm256_unpacklo_epi64(blacks, whites));
+  _mm256_storeu_si256((__m256i *)(boards + 2),
+                      _mm256_unpackhi_epi64(blacks, whites));
+}
+
+__m256i p_GenerateMoves4(__m256i own, __m256i opp) {
+  __m256i moves = _mm256_setzero_si256();
+  for (int d = 0; d < 4; ++d) {
+    __m256i s = _mm256_set1_epi64x(DIRECTION_SHIFTS[d]);
+    __m256i lmask = _mm256_set1_epi64x(LEFT_SHIFT_MASKS[d]);
+    __m256i rmask = _mm256_set1_epi64x(RIGHT_SHIFT_MASKS[d]);
+
+    __m256i lgen = p_FillLeft(own, _mm256_and_si256(opp, lmask), s);
+    __m256i rgen = p_FillRight(own, _mm256_and_si256(opp, rmask), s);
+    lgen = _mm256_sllv_epi64(_mm256_xor_si256(lgen, own), s);
+    rgen = _mm256_srlv_epi64(_mm256_xor_si256(rgen, own), s);
+    moves = _mm256_or_si256(moves, _mm256_and_si256(lmask, lgen));
+    moves = _mm256_or_si256(moves, _mm256_and_si256(rmask, rgen));
+  }
+  return _mm256_andnot_si256(_mm256_or_si256(own, opp), moves);
+}
+
+__m256i p_ComputeFlips4(__m256i own, __m256i opp, __m256i mv) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i flips = zero;
+  for (int d = 0; d < 4; ++d) {
+    __m256i s = _mm256_set1_epi64x(DIRECTION_SHIFTS[d]);
+    __m256i lmask = _mm256_set1_epi64x(LEFT_SHIFT_MASKS[d]);
+    __m256i rmask = _mm256_set1_epi64x(RIGHT_SHIFT_MASKS[d]);
+
+    __m256i lgen = p_FillLeft(mv, _mm256_and_si256(opp, lmask), s);
+    __m256i rgen = p_FillRight(mv, _mm256_and_si256(opp, rmask), s);
+    __m256i lend = _mm256_and_si256(lmask, _mm256_sllv_epi64(lgen, s));
+    __m256i rend = _mm256_and_si256(rmask, _mm256_srlv_epi64(rgen, s));
+    lend = _mm256_cmpeq_epi64(_mm256_and_si256(own, lend), zero);
+    rend = _mm256_cmpeq_epi64(_mm256_and_si256(own, rend), zero);
+    lgen = _mm256_andnot_si256(lend, _mm256_xor_si256(lgen, mv));
+    rgen = _mm256_andnot_si256(rend, _mm256_xor_si256(rgen, mv));
+    flips = _mm256_or_si256(flips, _mm256_or_si256(lgen, rgen));
+  }
+  return flips;
+}
+
+// Canonicalizes four boards at once. The eight symmetries are generated by
+// the top/bottom, left/right and diagonal mirrors, so the minimum is the same
+// one MakeBoardCanonical() finds with rotations.
+void p_MakeBoardsCanonical4(__m256i *blacks, __m256i *whites) {
+  __m256i b[8], w[8];
+  b[0] = *blacks;
+  w[0] = *whites;
+  b[1] = p_FlipTB4(b[0]);
+  w[1] = p_FlipTB4(w[0]);
+  b[2] = p_FlipLR4(b[0]);
+  w[2] = p_FlipLR4(w[0]);
+  b[3] = p_FlipLR4(b[1]);
+  w[3] = p_FlipLR4(w[1]);
+  for (int i = 0; i < 4; ++i) {
+    b[i + 4] = p_FlipDiag4(b[i]);
+    w[i + 4] = p_FlipDiag4(w[i]);
+  }
+  for (int i = 1; i < 8; ++i) {
+    p_KeepMin4(blacks, whites, b[i], w[i]);
+  }
+}
+#endif // REV_AVX2_MOVEGEN
+
+// Writes the move masks of count boards (all with turn to move) to moves.
+void GenerateMovesBatch(const Board *boards, int count, Turn turn,
+                        uint64_t *moves) {
+  int i = 0;
+#ifdef REV_AVX2_MOVEGEN
+  __m256i blacks, whites;
+  for (; i + 4 <= count; i += 4) {
+    p_LoadBoards4(boards + i, &blacks, &whites);
+    __m256i mv = (turn == BLACKS_TURN) ? p_GenerateMoves4(blacks, whites)
+                                       : p_GenerateMoves4(whites, blacks);
+    _mm256_storeu_si256((__m256i *)(moves + i), mv);
+  }
+#endif
+  for (; i < count; ++i) {
+    moves[i] = GenerateMoves(&boards[i], turn);
+  }
+}
+
+// Writes to children[i] the result of playing squares[i] on
+// boards[parents[i]], for i < count.
+void MakeMovesBatch(const Board *boards, const uint8_t *parents,
+                    const uint8_t *squares, int count, Turn turn,
+                    Board *children) {
+  int i = 0;
+#ifdef REV_AVX2_MOVEGEN
+  for (; i + 4 <= count; i += 4) {
+    const Board *p0 = &boards[parents[i]];
+    const Board *p1 = &boards[parents[i + 1]];
+    const Board *p2 = &boards[parents[i + 2]];
+    const Board *p3 = &boards[parents[i + 3]];
+    __m256i blacks =
+        _mm256_setr_epi64x(p0->blacks, p1->blacks, p2->blacks, p3->blacks);
+    __m256i whites =
+        _mm256_setr_epi64x(p0->whites, p1->whites, p2->whites, p3->whites);
+    __m256i mv = _mm256_sllv_epi64(
+        _mm256_set1_epi64x(1),
+        _mm256_setr_epi64x(squares[i], squares[i + 1], squares[i + 2],
+                           squares[i + 3]));
+
+    __m256i flip;
+    if (turn == BLACKS_TURN) {
+      flip = _mm256_or_si256(mv, p_ComputeFlips4(blacks, whites, mv));
+      blacks = _mm256_or_si256(blacks, flip);
+      whites = _mm256_andnot_si256(flip, whites);
+    } else {
+      flip = _mm256_or_si256(mv, p_ComputeFlips4(whites, blacks, mv));
+      blacks = _mm256_andnot_si256(flip, blacks);
+      whites = _mm256_or_si256(whites, flip);
+    }
+    p_StoreBoards4(children + i, blacks, whites);
+  }
+#endif
+  for (; i < count; ++i) {
+    children[i] = boards[parents[i]];
+    MakeMove(&children[i], turn, squares[i]);
+  }
+}
+
+void MakeBoardsCanonicalBatch(Board *boards, int count) {
+  int i = 0;
+#ifdef REV_AVX2_MOVEGEN
+  __m256i blacks, whites;
+  for (; i + 4 <= count; i += 4) {
+    p_LoadBoards4(boards + i, &blacks, &whites);
+    p_MakeBoardsCanonical4(&blacks, &whites);
+    p_StoreBoards4(boards + i, blacks, whites);
+  }
+#endif
+  for (; i < count; ++i) {
+    MakeBoardCanonical(&boards[i]);
+  }
+}
+
+// Expands up to BOARD_BATCH_SIZE boards (all with turn to move). Writes what
+// GenerateCanonicalChildBoards() would produce for each board, one after the
+// other, to children. Returns the total number of children written.
+int p_GenerateCanonicalChildBoardsBatch(const Board *boards, int count,
+                                        Turn turn, Board *children) {
+  uint64_t moves[BOARD_BATCH_SIZE];
+  uint8_t parents[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+  uint8_t squares[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+  int ends[BOARD_BATCH_SIZE];
+
+  GenerateMovesBatch(boards, count, turn, moves);
+
+  int num_moves = 0;
+  for (int i = 0; i < count; ++i) {
+    uint64_t m = moves[i];
+    while (m != 0) {
+      parents[num_moves] = i;
+      squares[num_moves] = __builtin_ctzll(m);
+      num_moves++;
+      m = m & (m - 1);
+    }
+    ends[i] = num_moves;
+  }
+  if (num_moves == 0) {
+    return 0;
+  }
+
+  MakeMovesBatch(boards, parents, squares, num_moves, turn, children);
+  MakeBoardsCanonicalBatch(children, num_moves);
+
+  // Drop children that are symmetric to an earlier sibling.
+  int num_children = 0;
+  int start = 0;
+  for (int i = 0; i < count; ++i) {
+    ChildSet siblings = {.used = 0};
+    Board *first = &children[num_children];
+    for (int j = start; j < ends[i]; ++j) {
+      children[num_children] = children[j];
+      if (p_ChildSetAdd(&siblings, first, &children[num_children] - first)) {
+        num_children++;
+      }
+    }
+    start = ends[i];
+  }
+  return num_children;
+}
+
+// Like p_GenerateCanonicalChildBoardsBatch() for any number of boards.
+// children must have room for count * MAX_NUM_CHILD_BOARDS boards.
+int GenerateCanonicalChildBoardsBatch(const Board *boards, int count,
+                                      Turn turn, Board *children) {
+  int num_children = 0;
+  for (int i = 0; i < count; i += BOARD_BATCH_SIZE) {
+    int n = (count - i < BOARD_BATCH_SIZE) ? count - i : BOARD_BATCH_SIZE;
+    num_children += p_GenerateCanonicalChildBoardsBatch(
+        boards + i, n, turn, children + num_children);
+  }
+  return num_children;
+}
+
 #endif // REV_BOARD_H_
@@ -1 +1,8 @@
-gcc -O3 -mbmi2 -fopenmp -o rev main.c
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o rev main.c -lm
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o perft perft.c
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o train train.c -lm
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o searchbench searchbench.c -lm
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o unique unique.c
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o aicheck aicheck.c -lm
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o evalcheck evalcheck.c
+gcc -O3 -Wall -mavx2 -mcx16 -fopenmp -o endgamecheck endgamecheck.c
@@ -0,0 +1,328 @@
+#ifndef REV_ENDGAME_H_
+#define REV_ENDGAME_H_
+
+#include "board.h"
+#include "search.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Scores here are exact disc differences (own minus opponent's discs at the
+// end of the game) from the point of view of the player to move.
+#define ENDGAME_INFINITY 65
+// Positions with this many empties or more are looked up in the cache. Below
+// that, solving again is cheaper than a table lookup.
+#define ENDGAME_CACHE_MIN_EMPTIES 7
+// Positions with this many empties or more order moves by the opponent's
+// mobility. Below that, parity alone decides.
+#define ENDGAME_MOBILITY_MIN_EMPTIES 7
+// Positions with at most this many empties use the kernels below, which try
+// the empty squares directly instead of generating moves.
+#define ENDGAME_SHALLOW_EMPTIES 4
+#define ENDGAME_TABLE_LOG_CAPACITY 20
+// Nodes between clock reads.
+#define ENDGAME_DEADLINE_CHECK_INTERVAL 256
+
+// The four 4x4 quadrants. Playing into a quadrant with an odd number of
+// empties tends to leave the last move there to us (parity).
+const uint64_t QUADRANTS[4] = {0x000000000F0F0F0F, 0x00000000F0F0F0F0,
+                               0x0F0F0F0F00000000, 0xF0F0F0F000000000};
+
+typedef struct EndgameSolver {
+  // Take over once a position has at most this many empties.
+  int max_empties;
+  // Solve for the exact disc difference, or only for win/draw/loss.
+  bool exact;
+  // Solved positions. Separate from the midgame table because its scores
+  // are disc differences, not evaluations.
+  SearchTable table;
+} EndgameSolver;
+
+EndgameSolver *EndgameSolverMake(int max_empties, bool exact) {
+  EndgameSolver *solver = (EndgameSolver *)malloc(sizeof(EndgameSolver));
+  solver->max_empties = max_empties;
+  solver->exact = exact;
+  SearchTableInit(&solver->table, ENDGAME_TABLE_LOG_CAPACITY);
+  return solver;
+}
+
+void EndgameSolverFree(EndgameSolver *solver) {
+  SearchTableFree(&solver->table);
+  free(solver);
+}
+
+// The empty squares that lie in quadrants with an odd number of empties.
+uint64_t p_OddQuadrantEmpties(uint64_t empties) {
+  uint64_t odd = 0;
+  for (int q = 0; q < 4; ++q) {
+    if (__builtin_popcountll(empties & QUADRANTS[q]) & 1) {
+      odd |= empties & QUADRANTS[q];
+    }
+  }
+  return odd;
+}
+
+int p_DiscDifference(const Board *board, Turn turn) {
+  int blacks = __builtin_popcountll(board->blacks);
+  int whites = __builtin_popcountll(board->whites);
+  return (turn == BLACKS_TURN) ? blacks - whites : whites - blacks;
+}
+
+// Last empty square: whoever can play there does, then the game is over.
+int p_SolveLast1(const Board *board, Turn turn, int square) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int difference = p_DiscDifference(board, turn);
+  uint64_t flips = ComputeFlips(board, turn, square);
+  if (flips != 0) {
+    return difference + 2 * __builtin_popcountll(flips) + 1;
+  }
+  flips = ComputeFlips(board, next_turn, square);
+  if (flips != 0) {
+    return difference - 2 * __builtin_popcountll(flips) - 1;
+  }
+  return difference;
+}
+
+// Solves positions with at most ENDGAME_SHALLOW_EMPTIES empties. Each empty
+// square is tried directly, odd quadrants first, and a square is a move if
+// it flips something.
+int p_SolveShallow(Searcher *searcher, const Board *board, Turn turn,
+                   int alpha, int beta, bool passed) {
+  uint64_t empties = EmptySquares(board);
+  if (empties == 0) {
+    return p_DiscDifference(board, turn);
+  } else if ((empties & (empties - 1)) == 0) {
+    return p_SolveLast1(board, turn, __builtin_ctzll(empties));
+  }
+  searcher->nodes++;
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+
+  uint64_t odd = p_OddQuadrantEmpties(empties);
+  uint64_t groups[2] = {odd, empties & ~odd};
+  int best = -ENDGAME_INFINITY;
+  for (int g = 0; g < 2; ++g) {
+    uint64_t squares = groups[g];
+    while (squares != 0) {
+      int square = __builtin_ctzll(squares);
+      squares = squares & (squares - 1);
+      uint64_t flips = ComputeFlips(board, turn, square);
+      if (flips == 0) {
+        continue;
+      }
+      Board child = *board;
+      ApplyMove(&child, turn, square, flips);
+      int score = -p_SolveShallow(searcher, &child, next_turn, -beta, -alpha,
+                                  false);
+      if (score > best) {
+        best = score;
+        if (score > alpha) {
+          alpha = score;
+          if (alpha >= beta) {
+            return best;
+          }
+        }
+      }
+    }
+  }
+
+  if (best == -ENDGAME_INFINITY) {
+    if (passed) {
+      return p_DiscDifference(board, turn);
+    }
+    return -p_SolveShallow(searcher, board, next_turn, -beta, -alpha, true);
+  }
+  return best;
+}
+
+// Writes the moves to squares, best first, and returns how many there are:
+// the cached move, then moves that leave the opponent the fewest replies,
+// with moves into odd quadrants breaking ties.
+int p_OrderEndgameMoves(const Board *board, Turn turn, uint64_t moves,
+                        int num_empties, int table_move, uint8_t *squares) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  uint64_t odd = p_OddQuadrantEmpties(EmptySquares(board));
+  int keys[MAX_NUM_CHILD_BOARDS];
+  int count = 0;
+  while (moves != 0) {
+    int square = __builtin_ctzll(moves);
+    moves = moves & (moves - 1);
+
+    int key = ((odd >> square) & 1) ? 1 : 0;
+    if (square == table_move) {
+      key = 1 << 20;
+    } else if (num_empties >= ENDGAME_MOBILITY_MIN_EMPTIES) {
+      Board child = *board;
+      MakeMove(&child, turn, square);
+      uint64_t replies = GenerateMoves(&child, next_turn);
+      key -= 4 * __builtin_popcountll(replies);
+      key += (replies & CORNERS) ? -4 : 0;
+    }
+
+    int i = count;
+    while (i > 0 && keys[i - 1] < key) {
+      keys[i] = keys[i - 1];
+      squares[i] = squares[i - 1];
+      --i;
+    }
+    keys[i] = key;
+    squares[i] = square;
+    count++;
+  }
+  return count;
+}
+
+// Fail-soft negamax over the rest of the game. Returns the exact score if it
+// lies strictly between alpha and beta, and otherwise a bound on the side of
+// the window it fell. hash must be ZobristHash(board).
+int EndgameSolve(Searcher *searcher, const Board *board, uint64_t hash,
+                 Turn turn, int alpha, int beta, bool passed) {
+  int num_empties = __builtin_popcountll(EmptySquares(board));
+  if (num_empties <= ENDGAME_SHALLOW_EMPTIES) {
+    return p_SolveShallow(searcher, board, turn, alpha, beta, passed);
+  }
+  searcher->nodes++;
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+
+  uint64_t moves = GenerateMoves(board, turn);
+  if (moves == 0) {
+    if (passed) {
+      return p_DiscDifference(board, turn);
+    }
+    return -EndgameSolve(searcher, board, hash, next_turn, -beta, -alpha,
+                         true);
+  }
+
+  if (DeadlinePassed(&searcher->deadline)) {
+    return 0;
+  }
+
+  int table_move = SEARCH_NO_MOVE;
+  bool cached = num_empties >= ENDGAME_CACHE_MIN_EMPTIES;
+  if (cached) {
+    SearchEntry entry;
+    if (SearchTableFind(searcher->table, board, hash, turn, &entry)) {
+      if (entry.best_move < 64 && ((moves >> entry.best_move) & 1)) {
+        table_move = entry.best_move;
+      }
+      if (entry.bound == SEARCH_EXACT) {
+        return entry.score;
+      } else if (entry.bound == SEARCH_LOWER && entry.score > alpha) {
+        alpha = entry.score;
+      } else if (entry.bound == SEARCH_UPPER && entry.score < beta) {
+        beta = entry.score;
+      }
+      if (alpha >= beta) {
+        return entry.score;
+      }
+    }
+  }
+
+  uint8_t squares[MAX_NUM_CHILD_BOARDS];
+  int count = p_OrderEndgameMoves(board, turn, moves, num_empties,
+                                  table_move, squares);
+
+  int alpha_orig = alpha;
+  int best = -ENDGAME_INFINITY;
+  int best_move = squares[0];
+  for (int i = 0; i < count; ++i) {
+    Board child = *board;
+    uint64_t flips = ComputeFlips(board, turn, squares[i]);
+    ApplyMove(&child, turn, squares[i], flips);
+    uint64_t child_hash = hash ^ ZobristMoveDelta(turn, squares[i], flips);
+    int score;
+    if (i == 0) {
+      score = -EndgameSolve(searcher, &child, child_hash, next_turn, -beta,
+                            -alpha, false);
+    } else {
+      score = -EndgameSolve(searcher, &child, child_hash, next_turn,
+                            -alpha - 1, -alpha, false);
+      if (score > alpha && score < beta) {
+        score = -EndgameSolve(searcher, &child, child_hash, next_turn, -beta,
+                              -score, false);
+      }
+    }
+    if (searcher->deadline.passed) {
+      return 0;
+    }
+    if (score > best) {
+      best = score;
+      best_move = squares[i];
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+  }
+
+  if (cached) {
+    SearchBound bound = SEARCH_EXACT;
+    if (best <= alpha_orig) {
+      bound = SEARCH_UPPER;
+    } else if (best >= beta) {
+      bound = SEARCH_LOWER;
+    }
+    SearchTableStore(searcher->table, board, hash, turn, num_empties, best,
+                     bound, best_move);
+  }
+  return best;
+}
+
+// Returns the best square among moves (the GenerateMoves() mask for turn)
+// and stores its score in score. For a win/draw/loss solve the score is only
+// known to be positive, zero or negative, and the first winning move found
+// is played. Returns -1 if deadline (a ClockNow() time, or NO_DEADLINE)
+// passes first.
+int EndgameBestSquare(EndgameSolver *solver, const Board *board, Turn turn,
+                      uint64_t moves, double deadline, int *score) {
+  Searcher searcher = {
+      .table = &solver->table,
+      .nodes = 0,
+      .deadline = DeadlineMake(deadline, ENDGAME_DEADLINE_CHECK_INTERVAL)};
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int alpha = solver->exact ? -ENDGAME_INFINITY : -1;
+  int beta = solver->exact ? ENDGAME_INFINITY : 1;
+
+  uint8_t squares[MAX_NUM_CHILD_BOARDS];
+  int count = p_OrderEndgameMoves(board, turn, moves,
+                                  ENDGAME_MOBILITY_MIN_EMPTIES,
+                                  SEARCH_NO_MOVE, squares);
+  int best = -ENDGAME_INFINITY;
+  int best_square = squares[0];
+  for (int i = 0; i < count; ++i) {
+    Board child = *board;
+    MakeMove(&child, turn, squares[i]);
+    uint64_t hash = ZobristHash(&child);
+    int value;
+    if (i == 0) {
+      value = -EndgameSolve(&searcher, &child, hash, next_turn, -beta, -alpha,
+                            false);
+    } else {
+      value = -EndgameSolve(&searcher, &child, hash, next_turn, -alpha - 1,
+                            -alpha, false);
+      if (value > alpha && value < beta) {
+        value = -EndgameSolve(&searcher, &child, hash, next_turn, -beta,
+                              -value, false);
+      }
+    }
+    if (searcher.deadline.passed) {
+      return -1;
+    }
+    if (value > best) {
+      best = value;
+      best_square = squares[i];
+      if (value > alpha) {
+        alpha = value;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+  }
+  *score = best;
+  return best_square;
+}
+
+#endif // REV_ENDGAME_H_
@@ -0,0 +1,142 @@
+// Endgame solver regression check. Solves random positions with few empties
+// with EndgameSolve() and EndgameBestSquare(), both exactly and for
+// win/draw/loss only, and compares them with a plain negamax over the whole
+// remaining game tree.
+//
+// Usage: ./endgamecheck [positions_per_count] [max_empties]
+
+#include "board.h"
+#include "endgame.h"
+#include "mtwister.h"
+#include "zobrist.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ENDGAMECHECK_MAX_EMPTIES 10
+
+// Exact final disc difference for turn, with no pruning or ordering.
+int Negamax(const Board *board, Turn turn, bool passed) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  uint64_t moves = GenerateMoves(board, turn);
+  if (moves == 0) {
+    if (passed) {
+      return p_DiscDifference(board, turn);
+    }
+    return -Negamax(board, next_turn, true);
+  }
+  int best = -ENDGAME_INFINITY;
+  for (; moves != 0; moves = moves & (moves - 1)) {
+    Board child = *board;
+    MakeMove(&child, turn, __builtin_ctzll(moves));
+    int score = -Negamax(&child, next_turn, false);
+    best = (score > best) ? score : best;
+  }
+  return best;
+}
+
+int Sign(int x) { return (x > 0) - (x < 0); }
+
+// Plays random moves from the opening until num_empties squares are empty,
+// with a side to move that has a move. Returns false if the game ended
+// first.
+bool RandomEndgame(int num_empties, MTRand *rng, Board *board, Turn *turn) {
+  *board = OpeningBoard();
+  *turn = BLACKS_TURN;
+  while (true) {
+    uint64_t moves = GenerateMoves(board, *turn);
+    if (moves == 0) {
+      *turn = (*turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+      moves = GenerateMoves(board, *turn);
+      if (moves == 0) {
+        return false;
+      }
+    }
+    if (__builtin_popcountll(EmptySquares(board)) == num_empties) {
+      return true;
+    }
+    int count = __builtin_popcountll(moves);
+    MakeMove(board, *turn, NthSetBit(moves, (int)genRandUniform(rng, count)));
+    *turn = (*turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  }
+}
+
+// Checks one position against negamax. Returns false on a mismatch.
+bool CheckEndgame(EndgameSolver *exact, EndgameSolver *wld,
+                  const Board *board, Turn turn) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int expected = Negamax(board, turn, false);
+  uint64_t moves = GenerateMoves(board, turn);
+
+  Searcher searcher = {.table = &exact->table,
+                       .nodes = 0,
+                       .deadline = DeadlineMake(NO_DEADLINE, 1)};
+  int solved = EndgameSolve(&searcher, board, ZobristHash(board), turn,
+                            -ENDGAME_INFINITY, ENDGAME_INFINITY, false);
+  searcher.table = &wld->table;
+  int solved_wld =
+      EndgameSolve(&searcher, board, ZobristHash(board), turn, -1, 1, false);
+
+  // The square each solver plays must be worth what it says.
+  int score = 0;
+  int square = EndgameBestSquare(exact, board, turn, moves, NO_DEADLINE,
+                                 &score);
+  Board child = *board;
+  MakeMove(&child, turn, square);
+  int played = -Negamax(&child, next_turn, false);
+
+  int score_wld = 0;
+  int square_wld =
+      EndgameBestSquare(wld, board, turn, moves, NO_DEADLINE, &score_wld);
+  child = *board;
+  MakeMove(&child, turn, square_wld);
+  int played_wld = -Negamax(&child, next_turn, false);
+
+  bool ok = solved == expected && Sign(solved_wld) == Sign(expected) &&
+            score == expected && played == expected &&
+            Sign(score_wld) == Sign(expected) &&
+            Sign(played_wld) == Sign(expected);
+  if (!ok) {
+    printf("  %d empties: negamax %d, solve %d, wld solve %d, best square "
+           "%d scored %d (worth %d), wld best square %d scored %d (worth "
+           "%d)\n",
+           __builtin_popcountll(EmptySquares(board)), expected, solved,
+           solved_wld, square, score, played, square_wld, score_wld,
+           played_wld);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int positions_per_count = (argc > 1) ? atoi(argv[1]) : 40;
+  int max_empties = (argc > 2) ? atoi(argv[2]) : ENDGAMECHECK_MAX_EMPTIES;
+
+  EndgameSolver *exact = EndgameSolverMake(max_empties, true);
+  EndgameSolver *wld = EndgameSolverMake(max_empties, false);
+  MTRand rng = seedRand(1);
+  bool ok = true;
+  for (int num_empties = 1; num_empties <= max_empties; ++num_empties) {
+    int num_failed = 0;
+    for (int found = 0; found < positions_per_count;) {
+      Board board;
+      Turn turn;
+      if (!RandomEndgame(num_empties, &rng, &board, &turn)) {
+        continue;
+      }
+      found++;
+      num_failed += !CheckEndgame(exact, wld, &board, turn);
+    }
+    printf("%2d empties: %4d positions  %s\n", num_empties,
+           positions_per_count, (num_failed == 0) ? "ok" : "MISMATCH");
+    ok = ok && num_failed == 0;
+  }
+  EndgameSolverFree(wld);
+  EndgameSolverFree(exact);
+
+  if (!ok) {
+    printf("\nendgamecheck FAILED\n");
+    return 1;
+  }
+  return 0;
+}
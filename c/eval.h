@@ -0,0 +1,358 @@
+#ifndef REV_EVAL_H_
+#define REV_EVAL_H_
+
+#include "board.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pattern evaluation. A pattern is a fixed set of squares given by a base
+// mask near the corner at square 0. It is read in all 8 symmetries of the
+// board (so each edge, corner and diagonal is covered), and each reading
+// (an instance) is a ternary code: digit i is 0, 1 or 2 for an empty, black
+// or white i-th square of the mask. Each pattern has one weight table per
+// game phase, shared by its instances, and the evaluation is the sum of the
+// instances' weights.
+//
+// Scores are in 1/EVAL_SCALE discs from black's point of view.
+
+#define EVAL_SCALE 16
+#define EVAL_NUM_SYMMETRIES 8
+#define EVAL_NUM_PATTERNS 8
+#define EVAL_NUM_INSTANCES (EVAL_NUM_SYMMETRIES * EVAL_NUM_PATTERNS)
+#define EVAL_MAX_PATTERN_SIZE 10
+// Phase k covers positions with 4 + 4k to 7 + 4k discs (the last one also
+// covers the full board).
+#define EVAL_NUM_PHASES 15
+// Most (instance, digit) pairs any square belongs to: a corner.
+#define EVAL_MAX_SQUARE_TERMS 12
+
+typedef enum {
+  EVAL_EDGE_2X,    // An edge plus its two X-squares.
+  EVAL_CORNER_3X3, // The 3x3 block in a corner.
+  EVAL_BLOCK_2X5,  // A 2x5 block in a corner, along an edge.
+  EVAL_DIAG_8,
+  EVAL_DIAG_7,
+  EVAL_DIAG_6,
+  EVAL_DIAG_5,
+  EVAL_DIAG_4,
+} EvalPattern;
+
+const uint64_t EVAL_PATTERN_MASKS[EVAL_NUM_PATTERNS] = {
+    0x00000000000042FF, 0x0000000000070707, 0x0000000000001F1F,
+    0x8040201008040201, 0x0080402010080402, 0x0000804020100804,
+    0x0000008040201008, 0x0000000080402010};
+
+// Weights per phase: the pattern tables back to back.
+const uint32_t EVAL_PATTERN_OFFSETS[EVAL_NUM_PATTERNS] = {
+    0, 59049, 78732, 137781, 144342, 146529, 147258, 147501};
+#define EVAL_PHASE_SIZE 147582
+
+typedef struct EvalWeights {
+  // EVAL_NUM_PHASES * EVAL_PHASE_SIZE weights.
+  int16_t *weights;
+} EvalWeights;
+
+// The ternary code of every instance, indexed by symmetry * EVAL_NUM_PATTERNS
+// + pattern.
+typedef struct EvalState {
+  uint16_t indices[EVAL_NUM_INSTANCES];
+} EvalState;
+
+// One digit of one instance that a square feeds.
+typedef struct EvalTerm {
+  uint8_t instance;
+  uint16_t pow3;
+} EvalTerm;
+
+EvalTerm EVAL_SQUARE_TERMS[64][EVAL_MAX_SQUARE_TERMS];
+uint8_t EVAL_NUM_SQUARE_TERMS[64];
+// Ternary value of a binary code: bit i becomes digit i.
+uint16_t EVAL_BINARY_TO_TERNARY[1 << EVAL_MAX_PATTERN_SIZE];
+
+// Writes the 8 symmetries of pieces, out[s] = SymmetricPieces(pieces, s),
+// sharing the flips between them.
+void p_EvalSymmetries(uint64_t pieces, uint64_t *out) {
+  out[0] = pieces;
+  out[1] = FlipPiecesLR(pieces);
+  out[2] = FlipPiecesTB(pieces);
+  out[3] = FlipPiecesLR(out[2]);
+  for (int s = 0; s < 4; ++s) {
+    out[4 + s] = FlipPiecesDiag(out[s]);
+  }
+}
+
+// Index extraction kernels. PEXT is the natural fit, but it is microcoded on
+// some CPUs, so, as for rotations, the faster kernel is picked at startup.
+typedef void EvalIndicesKernel(const Board *board, EvalState *state);
+
+__attribute__((target("bmi2"))) void p_EvalIndicesPext(const Board *board,
+                                                        EvalState *state) {
+  uint64_t blacks[EVAL_NUM_SYMMETRIES];
+  uint64_t whites[EVAL_NUM_SYMMETRIES];
+  p_EvalSymmetries(board->blacks, blacks);
+  p_EvalSymmetries(board->whites, whites);
+  for (int s = 0; s < EVAL_NUM_SYMMETRIES; ++s) {
+    for (int p = 0; p < EVAL_NUM_PATTERNS; ++p) {
+      uint64_t mask = EVAL_PATTERN_MASKS[p];
+      state->indices[s * EVAL_NUM_PATTERNS + p] =
+          EVAL_BINARY_TO_TERNARY[_pext_u64(blacks[s], mask)] +
+          2 * EVAL_BINARY_TO_TERNARY[_pext_u64(whites[s], mask)];
+    }
+  }
+}
+
+// Portable PEXT.
+uint64_t p_ExtractBits(uint64_t pieces, uint64_t mask) {
+  uint64_t bits = 0;
+  for (uint64_t bit = 1; mask != 0; bit <<= 1) {
+    if (pieces & mask & -mask) {
+      bits |= bit;
+    }
+    mask = mask & (mask - 1);
+  }
+  return bits;
+}
+
+void p_EvalIndicesScalar(const Board *board, EvalState *state) {
+  uint64_t blacks[EVAL_NUM_SYMMETRIES];
+  uint64_t whites[EVAL_NUM_SYMMETRIES];
+  p_EvalSymmetries(board->blacks, blacks);
+  p_EvalSymmetries(board->whites, whites);
+  for (int s = 0; s < EVAL_NUM_SYMMETRIES; ++s) {
+    for (int p = 0; p < EVAL_NUM_PATTERNS; ++p) {
+      uint64_t mask = EVAL_PATTERN_MASKS[p];
+      state->indices[s * EVAL_NUM_PATTERNS + p] =
+          EVAL_BINARY_TO_TERNARY[p_ExtractBits(blacks[s], mask)] +
+          2 * EVAL_BINARY_TO_TERNARY[p_ExtractBits(whites[s], mask)];
+    }
+  }
+}
+
+EvalIndicesKernel *EVAL_INDICES_KERNEL = p_EvalIndicesScalar;
+
+// Returns the best of a few timings of num_calls calls, in cycles.
+uint64_t p_ProbeEvalKernel(EvalIndicesKernel *kernel) {
+  const int num_calls = 256;
+  Board board = OpeningBoard();
+  EvalState state;
+  uint64_t best = UINT64_MAX;
+  for (int trial = 0; trial < 3; ++trial) {
+    uint64_t t0 = __rdtsc();
+    for (int i = 0; i < num_calls; ++i) {
+      kernel(&board, &state);
+      board.blacks ^= state.indices[i % EVAL_NUM_INSTANCES];
+    }
+    uint64_t t1 = __rdtsc();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+    }
+  }
+  return best;
+}
+
+__attribute__((constructor)) void p_EvalInitTables() {
+  for (int code = 0; code < (1 << EVAL_MAX_PATTERN_SIZE); ++code) {
+    int ternary = 0;
+    for (int i = EVAL_MAX_PATTERN_SIZE - 1; i >= 0; --i) {
+      ternary = 3 * ternary + ((code >> i) & 1);
+    }
+    EVAL_BINARY_TO_TERNARY[code] = ternary;
+  }
+
+  for (int square = 0; square < 64; ++square) {
+    EVAL_NUM_SQUARE_TERMS[square] = 0;
+    for (int s = 0; s < EVAL_NUM_SYMMETRIES; ++s) {
+      uint64_t target = SymmetricPieces(1ULL << square, s);
+      for (int p = 0; p < EVAL_NUM_PATTERNS; ++p) {
+        uint64_t mask = EVAL_PATTERN_MASKS[p];
+        if ((target & mask) == 0) {
+          continue;
+        }
+        int digit = __builtin_popcountll(mask & (target - 1));
+        uint16_t pow3 = 1;
+        for (int i = 0; i < digit; ++i) {
+          pow3 *= 3;
+        }
+        EvalTerm *term =
+            &EVAL_SQUARE_TERMS[square][EVAL_NUM_SQUARE_TERMS[square]++];
+        term->instance = s * EVAL_NUM_PATTERNS + p;
+        term->pow3 = pow3;
+      }
+    }
+  }
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("bmi2") &&
+      p_ProbeEvalKernel(p_EvalIndicesPext) <
+          p_ProbeEvalKernel(p_EvalIndicesScalar)) {
+    EVAL_INDICES_KERNEL = p_EvalIndicesPext;
+  }
+}
+
+const char *EvalKernelName() {
+  return (EVAL_INDICES_KERNEL == p_EvalIndicesPext) ? "pext" : "scalar";
+}
+
+void EvalStateInit(EvalState *state, const Board *board) {
+  EVAL_INDICES_KERNEL(board, state);
+}
+
+// Updates state for a move by turn on square that flips flips, i.e. for
+// ApplyMove(board, turn, square, flips).
+void EvalStateUpdate(EvalState *state, Turn turn, int square,
+                     uint64_t flips) {
+  // Placing adds the player's digit. Flipping turns a 2 into a 1 for black
+  // and a 1 into a 2 for white.
+  int placed = (turn == BLACKS_TURN) ? 1 : 2;
+  int flipped = (turn == BLACKS_TURN) ? -1 : 1;
+  for (int t = 0; t < EVAL_NUM_SQUARE_TERMS[square]; ++t) {
+    const EvalTerm *term = &EVAL_SQUARE_TERMS[square][t];
+    state->indices[term->instance] += placed * term->pow3;
+  }
+  while (flips != 0) {
+    int flip = __builtin_ctzll(flips);
+    flips = flips & (flips - 1);
+    for (int t = 0; t < EVAL_NUM_SQUARE_TERMS[flip]; ++t) {
+      const EvalTerm *term = &EVAL_SQUARE_TERMS[flip][t];
+      state->indices[term->instance] += flipped * term->pow3;
+    }
+  }
+}
+
+int EvalPhase(int num_discs) {
+  int phase = (num_discs - 4) / 4;
+  return (phase < EVAL_NUM_PHASES) ? phase : EVAL_NUM_PHASES - 1;
+}
+
+// Evaluation of the position state describes, which has num_discs discs.
+int EvalScore(const EvalWeights *weights, const EvalState *state,
+              int num_discs) {
+  const int16_t *table =
+      weights->weights + EvalPhase(num_discs) * EVAL_PHASE_SIZE;
+  int score = 0;
+  for (int s = 0; s < EVAL_NUM_SYMMETRIES; ++s) {
+    const uint16_t *indices = &state->indices[s * EVAL_NUM_PATTERNS];
+    for (int p = 0; p < EVAL_NUM_PATTERNS; ++p) {
+      score += table[EVAL_PATTERN_OFFSETS[p] + indices[p]];
+    }
+  }
+  return score;
+}
+
+int EvalBoard(const EvalWeights *weights, const Board *board) {
+  EvalState state;
+  EvalStateInit(&state, board);
+  return EvalScore(weights, &state,
+                   __builtin_popcountll(board->blacks | board->whites));
+}
+
+void EvalWeightsInit(EvalWeights *weights) {
+  weights->weights = (int16_t *)calloc(EVAL_NUM_PHASES * EVAL_PHASE_SIZE,
+                                       sizeof(int16_t));
+}
+
+void EvalWeightsFree(EvalWeights *weights) {
+  free(weights->weights);
+  weights->weights = NULL;
+}
+
+// Square values for EvalDefaultWeights(), in 1/EVAL_SCALE discs.
+const int EVAL_SQUARE_VALUES[64] = {
+    100, -20, 10, 5,  5,  10, -20, 100, //
+    -20, -50, -2, -2, -2, -2, -50, -20, //
+    10,  -2,  -1, -1, -1, -1, -2,  10,  //
+    5,   -2,  -1, -1, -1, -1, -2,  5,   //
+    5,   -2,  -1, -1, -1, -1, -2,  5,   //
+    10,  -2,  -1, -1, -1, -1, -2,  10,  //
+    -20, -50, -2, -2, -2, -2, -50, -20, //
+    100, -20, 10, 5,  5,  10, -20, 100};
+
+// Fills weights so that the evaluation is a fixed square-value table
+// (corners good, X- and C-squares bad), the same in every phase. Each
+// square's value is split evenly among the instance digits it feeds. This is
+// only a starting point until trained weights are loaded.
+void EvalDefaultWeights(EvalWeights *weights) {
+  for (int p = 0; p < EVAL_NUM_PATTERNS; ++p) {
+    uint64_t mask = EVAL_PATTERN_MASKS[p];
+    int size = __builtin_popcountll(mask);
+    double shares[EVAL_MAX_PATTERN_SIZE];
+    for (int digit = 0; digit < size; ++digit) {
+      int square = __builtin_ctzll(mask);
+      mask = mask & (mask - 1);
+      shares[digit] = EVAL_SQUARE_VALUES[square] /
+                      (double)EVAL_NUM_SQUARE_TERMS[square];
+    }
+
+    int num_codes = 1;
+    for (int digit = 0; digit < size; ++digit) {
+      num_codes *= 3;
+    }
+    for (int code = 0; code < num_codes; ++code) {
+      double value = 0.0;
+      int rest = code;
+      for (int digit = 0; digit < size; ++digit) {
+        if (rest % 3 == 1) {
+          value += shares[digit];
+        } else if (rest % 3 == 2) {
+          value -= shares[digit];
+        }
+        rest /= 3;
+      }
+      int16_t weight = (int16_t)(value + (value < 0 ? -0.5 : 0.5));
+      for (int phase = 0; phase < EVAL_NUM_PHASES; ++phase) {
+        weights->weights[phase * EVAL_PHASE_SIZE + EVAL_PATTERN_OFFSETS[p] +
+                         code] = weight;
+      }
+    }
+  }
+}
+
+// Weight files: "REVW", then the version, the number of phases and the
+// phase size as uint32, then the int16 weights, all little-endian.
+#define EVAL_WEIGHTS_VERSION 1
+
+bool EvalSaveWeights(const EvalWeights *weights, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  uint32_t header[3] = {EVAL_WEIGHTS_VERSION, EVAL_NUM_PHASES,
+                        EVAL_PHASE_SIZE};
+  size_t count = EVAL_NUM_PHASES * EVAL_PHASE_SIZE;
+  bool ok = fwrite("REVW", 1, 4, file) == 4 &&
+            fwrite(header, sizeof(uint32_t), 3, file) == 3 &&
+            fwrite(weights->weights, sizeof(int16_t), count, file) == count;
+  return fclose(file) == 0 && ok;
+}
+
+// Returns false, leaving weights unchanged, if the file is missing or does
+// not match this build's patterns.
+bool EvalLoadWeights(EvalWeights *weights, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  char magic[4];
+  uint32_t header[3];
+  bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "REVW", 4) == 0 &&
+            fread(header, sizeof(uint32_t), 3, file) == 3 &&
+            header[0] == EVAL_WEIGHTS_VERSION &&
+            header[1] == EVAL_NUM_PHASES && header[2] == EVAL_PHASE_SIZE;
+  size_t count = EVAL_NUM_PHASES * EVAL_PHASE_SIZE;
+  if (ok) {
+    int16_t *loaded = (int16_t *)malloc(count * sizeof(int16_t));
+    ok = fread(loaded, sizeof(int16_t), count, file) == count;
+    if (ok) {
+      memcpy(weights->weights, loaded, count * sizeof(int16_t));
+    }
+    free(loaded);
+  }
+  fclose(file);
+  return ok;
+}
+
+#endif // REV_EVAL_H_
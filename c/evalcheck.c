@@ -0,0 +1,140 @@
+// Pattern evaluation regression check. Plays random games and, after every
+// move, checks that the incrementally updated EvalState equals the one
+// computed from scratch by each index kernel, and that the score under
+// random weights is the same for all 8 symmetric images of the board.
+// Also checks that weights survive EvalSaveWeights() and EvalLoadWeights(),
+// and that a truncated file is rejected.
+//
+// Usage: ./evalcheck [num_games]
+
+#include "board.h"
+#include "eval.h"
+#include "mtwister.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void RandomWeights(EvalWeights *weights, MTRand *rng) {
+  for (int i = 0; i < EVAL_NUM_PHASES * EVAL_PHASE_SIZE; ++i) {
+    weights->weights[i] = (int16_t)genRandUniform(rng, 2001) - 1000;
+  }
+}
+
+// Returns the number of positions where a check failed, printing the first
+// few.
+int CheckEvalState(const Board *board, const EvalState *incremental,
+                   const EvalWeights *weights, int *num_reported) {
+  EvalIndicesKernel *kernels[2] = {p_EvalIndicesScalar, p_EvalIndicesPext};
+  const char *names[2] = {"scalar", "pext"};
+  int num_kernels = __builtin_cpu_supports("bmi2") ? 2 : 1;
+
+  bool ok = true;
+  for (int k = 0; k < num_kernels; ++k) {
+    EvalState scratch;
+    kernels[k](board, &scratch);
+    if (memcmp(scratch.indices, incremental->indices,
+               sizeof(scratch.indices)) != 0) {
+      if ((*num_reported)++ < 5) {
+        printf("  incremental indices differ from %s\n", names[k]);
+      }
+      ok = false;
+    }
+  }
+
+  int num_discs = __builtin_popcountll(board->blacks | board->whites);
+  int score = EvalScore(weights, incremental, num_discs);
+  for (int s = 1; s < EVAL_NUM_SYMMETRIES; ++s) {
+    Board image = SymmetricBoard(board, s);
+    int image_score = EvalBoard(weights, &image);
+    if (image_score != score) {
+      if ((*num_reported)++ < 5) {
+        printf("  score %d, but %d under symmetry %d\n", score, image_score,
+               s);
+      }
+      ok = false;
+    }
+  }
+  return !ok;
+}
+
+// Returns false if the weights do not come back unchanged from a file, or a
+// truncated copy of the file is accepted or changes the weights.
+bool CheckWeightsRoundTrip(const EvalWeights *weights) {
+  char path[] = "/tmp/evalcheck_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    printf("weights round trip: cannot create a temporary file  FAILED\n");
+    return false;
+  }
+  close(fd);
+
+  size_t size = EVAL_NUM_PHASES * EVAL_PHASE_SIZE * sizeof(int16_t);
+  EvalWeights loaded;
+  EvalWeightsInit(&loaded);
+  bool ok = EvalSaveWeights(weights, path) && EvalLoadWeights(&loaded, path) &&
+            memcmp(loaded.weights, weights->weights, size) == 0;
+
+  // Drop the last weight. Loading must fail and leave loaded as it was.
+  bool rejected = truncate(path, 16 + size - sizeof(int16_t)) == 0 &&
+                  !EvalLoadWeights(&loaded, path) &&
+                  memcmp(loaded.weights, weights->weights, size) == 0;
+  unlink(path);
+  EvalWeightsFree(&loaded);
+
+  printf("weights round trip: %s, truncated file %s  %s\n",
+         ok ? "same" : "DIFFERENT", rejected ? "rejected" : "ACCEPTED",
+         (ok && rejected) ? "ok" : "FAILED");
+  return ok && rejected;
+}
+
+int main(int argc, char **argv) {
+  int num_games = (argc > 1) ? atoi(argv[1]) : 200;
+
+  printf("index kernel: %s\n", EvalKernelName());
+  MTRand rng = seedRand(1);
+  EvalWeights weights;
+  EvalWeightsInit(&weights);
+  RandomWeights(&weights, &rng);
+
+  int num_positions = 0;
+  int num_failed = 0;
+  int num_reported = 0;
+  for (int g = 0; g < num_games; ++g) {
+    Board board = OpeningBoard();
+    Turn turn = BLACKS_TURN;
+    EvalState state;
+    EvalStateInit(&state, &board);
+    while (true) {
+      uint64_t moves = GenerateMoves(&board, turn);
+      if (moves == 0) {
+        turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+        moves = GenerateMoves(&board, turn);
+        if (moves == 0) {
+          break;
+        }
+      }
+      int count = __builtin_popcountll(moves);
+      int square = NthSetBit(moves, (int)genRandUniform(&rng, count));
+      uint64_t flips = ComputeFlips(&board, turn, square);
+      ApplyMove(&board, turn, square, flips);
+      EvalStateUpdate(&state, turn, square, flips);
+      turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+
+      num_positions++;
+      num_failed += CheckEvalState(&board, &state, &weights, &num_reported);
+    }
+  }
+
+  printf("%d games, %d positions: %d failed  %s\n", num_games, num_positions,
+         num_failed, (num_failed == 0) ? "ok" : "MISMATCH");
+  bool ok = CheckWeightsRoundTrip(&weights) && num_failed == 0;
+  EvalWeightsFree(&weights);
+  if (!ok) {
+    printf("\nevalcheck FAILED\n");
+    return 1;
+  }
+  return 0;
+}
@@ -6,6 +6,9 @@
 #include "mtwister.h"
 #include "table.h"
 
+#include <omp.h>
+#include <stdlib.h>
+
 void CollectBoardsBreadthFirst(Board *start, Turn turn, int num_turns,
                                BoardList *list) {
   ResetBoardIter(list);
@@ -14,14 +17,16 @@ void CollectBoardsBreadthFirst(Board *start, Turn turn, int num_turns,
   for (int i = 0; i < num_turns; ++i) {
     Board *last = LastBoard(list);
     Board *next;
+    int count;
 
-    ChildBoards children;
-    while (next = NextBoard(list)) {
+    Board children[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+    while ((next = NextBoards(list, last, BOARD_BATCH_SIZE, &count))) {
 
-      GenerateCanonicalChildBoards(next, turn, &children);
-      AddChildBoards(list, &children);
+      int num_children =
+          GenerateCanonicalChildBoardsBatch(next, count, turn, children);
+      AddBoards(list, children, num_children);
 
-      if (next == last) {
+      if (next + count - 1 == last) {
         break;
       }
     }
@@ -42,19 +47,21 @@ void CollectBoardSetBreadthFirst(Board *start, Turn turn, int num_turns,
   for (int i = 0; i < num_turns; ++i) {
     Board *last = LastBoard(&list);
     Board *next;
+    int count;
 
-    ChildBoards children;
-    while (next = NextBoard(&list)) {
+    Board children[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+    while ((next = NextBoards(&list, last, BOARD_BATCH_SIZE, &count))) {
 
-      GenerateCanonicalChildBoards(next, turn, &children);
-      for (int j = 0; j < children.count; ++j) {
-        if (!BoardSetHas(set, &children.boards[j])) {
-          BoardSetAdd(set, &children.boards[j]);
-          AddBoard(&list, &children.boards[j]);
+      int num_children =
+          GenerateCanonicalChildBoardsBatch(next, count, turn, children);
+      for (int j = 0; j < num_children; ++j) {
+        if (!BoardSetHas(set, &children[j])) {
+          BoardSetAdd(set, &children[j]);
+          AddBoard(&list, &children[j]);
         }
       }
 
-      if (next == last) {
+      if (next + count - 1 == last) {
         break;
       }
     }
@@ -77,6 +84,215 @@ void CollectBoardSetBreadthFirst(Board *start, Turn turn, int num_turns,
   }
 }
 
+// CollectBoardSetBreadthFirst() with a FlatBoardSet, which takes each
+// batch of children at once.
+void CollectFlatBoardSetBreadthFirst(Board *start, Turn turn, int num_turns,
+                                     FlatBoardSet *set) {
+  BoardList list = MakeBoardList();
+  AddBoard(&list, start);
+
+  for (int i = 0; i < num_turns; ++i) {
+    Board *last = LastBoard(&list);
+    Board *next;
+    int count;
+
+    Board children[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+    bool added[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+    while ((next = NextBoards(&list, last, BOARD_BATCH_SIZE, &count))) {
+
+      int num_children =
+          GenerateCanonicalChildBoardsBatch(next, count, turn, children);
+      FlatBoardSetAddBatch(set, children, num_children, added);
+      for (int j = 0; j < num_children; ++j) {
+        if (added[j]) {
+          AddBoard(&list, &children[j]);
+        }
+      }
+
+      if (next + count - 1 == last) {
+        break;
+      }
+    }
+
+    // Prune already-processed buckets.
+    while (list.head != list.iter.curr) {
+      BoardBucket *temp = list.head;
+      list.head = list.head->next;
+
+      temp->next = NULL;
+      temp->count = 0;
+      free(temp);
+    }
+
+    if (turn == BLACKS_TURN) {
+      turn = WHITES_TURN;
+    } else {
+      turn = BLACKS_TURN;
+    }
+  }
+  BoardListClear(&list);
+}
+
+// Boards per unit of work in CollectBoardSetBreadthFirstParallel().
+#define EXPLORE_SLICE_SIZE (32 * BOARD_BATCH_SIZE)
+
+// A run of boards that are contiguous in memory.
+typedef struct BoardSlice {
+  const Board *boards;
+  int count;
+} BoardSlice;
+
+// Cuts the boards of lists into slices of at most EXPLORE_SLICE_SIZE boards.
+// Returns the slices (to be freed by the caller) and stores their number in
+// count.
+BoardSlice *p_SliceBoardLists(BoardList *lists, int num_lists, int *count) {
+  int capacity = 1024;
+  BoardSlice *slices = (BoardSlice *)malloc(capacity * sizeof(BoardSlice));
+  *count = 0;
+  for (int l = 0; l < num_lists; ++l) {
+    for (BoardBucket *b = lists[l].head; b != NULL; b = b->next) {
+      for (int i = 0; i < b->count; i += EXPLORE_SLICE_SIZE) {
+        if (*count == capacity) {
+          capacity *= 2;
+          slices =
+              (BoardSlice *)realloc(slices, capacity * sizeof(BoardSlice));
+        }
+        int n = b->count - i;
+        slices[*count].boards = &b->boards[i];
+        slices[*count].count =
+            (n < EXPLORE_SLICE_SIZE) ? n : EXPLORE_SLICE_SIZE;
+        (*count)++;
+      }
+    }
+  }
+  return slices;
+}
+
+// Adds board to a thread-safe set unless it is there already. Returns
+// whether it was added.
+typedef bool AddBoardIfAbsent(void *set, const Board *board);
+
+bool p_AddToShardedBoardSet(void *set, const Board *board) {
+  return ShardedBoardSetAddIfAbsent((ShardedBoardSet *)set, board);
+}
+
+bool p_AddToConcurrentBoardSet(void *set, const Board *board) {
+  return ConcurrentBoardSetAdd((ConcurrentBoardSet *)set, board);
+}
+
+// CollectBoardSetBreadthFirst() on num_threads threads. Each ply, the
+// threads expand slices of the frontier and add the children to set; every
+// thread keeps the children it was first to add in its own list, and those
+// lists together are the next frontier. Ends with the same set.
+void p_CollectBreadthFirstParallel(Board *start, Turn turn, int num_turns,
+                                   int num_threads, void *set,
+                                   AddBoardIfAbsent *add) {
+  BoardList *frontier = (BoardList *)malloc(num_threads * sizeof(BoardList));
+  BoardList *next = (BoardList *)malloc(num_threads * sizeof(BoardList));
+  for (int t = 0; t < num_threads; ++t) {
+    frontier[t] = MakeBoardList();
+    next[t] = MakeBoardList();
+  }
+  AddBoard(&frontier[0], start);
+
+  for (int i = 0; i < num_turns; ++i) {
+    int num_slices;
+    BoardSlice *slices = p_SliceBoardLists(frontier, num_threads, &num_slices);
+
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+    for (int s = 0; s < num_slices; ++s) {
+      BoardList *own = &next[omp_get_thread_num()];
+      Board children[BOARD_BATCH_SIZE * MAX_NUM_CHILD_BOARDS];
+      for (int b = 0; b < slices[s].count; b += BOARD_BATCH_SIZE) {
+        int count = slices[s].count - b;
+        count = (count < BOARD_BATCH_SIZE) ? count : BOARD_BATCH_SIZE;
+        int num_children = GenerateCanonicalChildBoardsBatch(
+            slices[s].boards + b, count, turn, children);
+        for (int j = 0; j < num_children; ++j) {
+          if (add(set, &children[j])) {
+            AddBoard(own, &children[j]);
+          }
+        }
+      }
+    }
+
+    free(slices);
+    for (int t = 0; t < num_threads; ++t) {
+      BoardListClear(&frontier[t]);
+      frontier[t] = next[t];
+      next[t] = MakeBoardList();
+    }
+
+    if (turn == BLACKS_TURN) {
+      turn = WHITES_TURN;
+    } else {
+      turn = BLACKS_TURN;
+    }
+  }
+
+  for (int t = 0; t < num_threads; ++t) {
+    BoardListClear(&frontier[t]);
+  }
+  free(next);
+  free(frontier);
+}
+
+void CollectBoardSetBreadthFirstParallel(Board *start, Turn turn,
+                                         int num_turns, int num_threads,
+                                         ShardedBoardSet *set) {
+  p_CollectBreadthFirstParallel(start, turn, num_turns, num_threads, set,
+                                p_AddToShardedBoardSet);
+}
+
+void CollectConcurrentBoardSetBreadthFirst(Board *start, Turn turn,
+                                           int num_turns, int num_threads,
+                                           ConcurrentBoardSet *set) {
+  p_CollectBreadthFirstParallel(start, turn, num_turns, num_threads, set,
+                                p_AddToConcurrentBoardSet);
+}
+
+// Counts the leaves of the game tree num_turns plies below start. A pass
+// counts as a ply, and a game that ends early counts as one leaf. With
+// canonical set, symmetric siblings are only counted once (the tree of
+// GenerateCanonicalChildBoards).
+uint64_t Perft(Board *start, Turn turn, int num_turns, bool canonical) {
+  if (num_turns == 0) {
+    return 1;
+  }
+
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  uint64_t moves = GenerateMoves(start, turn);
+  if (moves == 0) {
+    if (GenerateMoves(start, next_turn) == 0) {
+      return 1;
+    }
+    return Perft(start, next_turn, num_turns - 1, canonical);
+  }
+
+  uint64_t count = 0;
+  if (canonical) {
+    ChildBoards children;
+    GenerateCanonicalChildBoards(start, turn, &children);
+    if (num_turns == 1) {
+      return children.count;
+    }
+    for (int i = 0; i < children.count; ++i) {
+      count += Perft(&children.boards[i], next_turn, num_turns - 1, true);
+    }
+  } else {
+    if (num_turns == 1) {
+      return __builtin_popcountll(moves);
+    }
+    while (moves != 0) {
+      Board child = *start;
+      MakeMove(&child, turn, __builtin_ctzll(moves));
+      moves = moves & (moves - 1);
+      count += Perft(&child, next_turn, num_turns - 1, false);
+    }
+  }
+  return count;
+}
+
 // Uniformly-sample across moves num_turns times. Return the resulting board.
 Board RandomSampleBoardDepthFirst(Board *start, Turn turn, int num_turns,
                                   MTRand *rng) {
@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define BUCKET_SIZE 500000
 
@@ -72,6 +73,25 @@ void AddChildBoards(BoardList *list, const ChildBoards *children) {
   }
 }
 
+void AddBoards(BoardList *list, const Board *boards, int count) {
+  while (count > 0) {
+    if (list->head == NULL || list->tail == NULL) {
+      AddBucket(list);
+      list->head = list->tail;
+    }
+    if (list->tail->count >= BUCKET_SIZE) {
+      AddBucket(list);
+    }
+
+    int room = BUCKET_SIZE - list->tail->count;
+    int n = (count < room) ? count : room;
+    memcpy(&list->tail->boards[list->tail->count], boards, n * sizeof(Board));
+    list->tail->count += n;
+    boards += n;
+    count -= n;
+  }
+}
+
 void BoardListClear(BoardList *list) {
   list->iter.curr = NULL;
   list->iter.index = 0;
@@ -116,6 +136,31 @@ Board *NextBoard(BoardList *list) {
   return found;
 }
 
+// Like NextBoard(), but returns a run of up to max_count boards that are
+// contiguous in memory and stores its length in count. The run stops early at
+// last, unless last is NULL. Returns NULL if at the end of the list.
+Board *NextBoards(BoardList *list, const Board *last, int max_count,
+                  int *count) {
+  Board *found = NULL;
+  *count = 0;
+  if (list->iter.curr->count >= BUCKET_SIZE &&
+      list->iter.index >= BUCKET_SIZE && list->iter.curr->next != NULL) {
+    list->iter.curr = list->iter.curr->next;
+    list->iter.index = 0;
+  }
+  int available = list->iter.curr->count - list->iter.index;
+  if (available > 0) {
+    found = &list->iter.curr->boards[list->iter.index];
+    int n = (available < max_count) ? available : max_count;
+    if (last != NULL && last >= found && last < found + n) {
+      n = last - found + 1;
+    }
+    list->iter.index += n;
+    *count = n;
+  }
+  return found;
+}
+
 Board *LastBoard(BoardList *list) {
   Board *found = NULL;
   if (list->tail != NULL) {
@@ -127,7 +172,7 @@ Board *LastBoard(BoardList *list) {
 uint32_t BoardListSize(BoardList *list) {
   BoardBucket *curr = list->head;
   uint32_t size = curr->count;
-  while (curr = curr->next) {
+  while ((curr = curr->next)) {
     size += curr->count;
   }
   return size;
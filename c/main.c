@@ -1,7 +1,9 @@
 #include "ai.h"
 #include "board.h"
+#include "eval.h"
 #include "explore.h"
 #include "list.h"
+#include "match.h"
 #include "mtwister.h"
 #include "table.h"
 
@@ -35,6 +37,7 @@ void scratchpad() {
   for (int i = 0; i < 10; ++i) {
     uint64_t sample = genRandUniform(&rng, 10);
     // printf("%lu\n", sample);
+    (void)sample;
   }
 
   BoardList list = MakeBoardList();
@@ -59,6 +62,7 @@ void scratchpad() {
     Board sample =
         RandomSampleBoardDepthFirst(&opening_board, BLACKS_TURN, 25, &rng);
     // PrintBoard(&sample);
+    (void)sample;
   }
 
   BoardList sample_list = MakeBoardList();
@@ -69,6 +73,7 @@ void scratchpad() {
                                &sample_list);
   t1 = clock();
   double dfs_time = (double)(t1 - t0) / CLOCKS_PER_SEC;
+  (void)dfs_time;
 
   // printf("Depth First Samples:\n");
   // while (next = NextBoard(&sample_list)) {
@@ -77,7 +82,6 @@ void scratchpad() {
 
   printf("%d, %d\n", BoardListSize(&list), BoardListSize(&sample_list));
 
-  Board table[500];
   EvaluateHash32Function(&sample_list, hash1);
   EvaluateHash32Function(&sample_list, hash2);
   EvaluateHash32Function(&sample_list, hash3);
@@ -106,7 +110,7 @@ void scratchpad() {
   BoardSetInit(&set);
 
   ResetBoardIter(&list);
-  while (next = NextBoard(&list)) {
+  while ((next = NextBoard(&list))) {
     if (BoardSetHas(&set, next)) {
       printf("Found a duplicate board. Yay!\n");
       continue;
@@ -124,26 +128,55 @@ void scratchpad() {
   printf("load: %f\n", set.size / (float)BoardSetCapacity(&set));
 }
 
-void ai_stuff() {
+// weights, if not NULL, are what alpha-beta evaluates with.
+void ai_stuff(const EvalWeights *weights) {
   AI random = AIMakeRandom();
   AI greedy = AIMakeGreedy();
   AI pure_mcts = AIMakePureMCTS(100);
+  AI uct = AIMakeUCT(100, 1);
+  AI alpha_beta = AIMakeAlphaBeta(6, 1);
+  if (weights != NULL) {
+    AIAlphaBetaUseWeights(&alpha_beta, weights);
+  }
+  AIEnableEndgameSolver(&alpha_beta, 16, true);
+  // Fixed, so that reruns play the same games.
+  const uint64_t seed = 1;
+
+  PlayTournament(&random, &random, 10000, seed);
+  PlayTournament(&random, &greedy, 10000, seed);
+  PlayTournament(&greedy, &random, 10000, seed);
+  PlayTournament(&greedy, &greedy, 10000, seed);
 
-  PlayTournament(&random, &random, 10000);
-  PlayTournament(&random, &greedy, 10000);
-  PlayTournament(&greedy, &random, 10000);
-  PlayTournament(&greedy, &greedy, 10000);
+  PlayTournament(&random, &pure_mcts, 400, seed);
+  PlayTournament(&greedy, &pure_mcts, 400, seed);
 
-  PlayTournament(&random, &pure_mcts, 400);
-  PlayTournament(&greedy, &pure_mcts, 400);
+  MatchSettings settings = MatchSettingsMake(200, seed);
+  PlayMatch(&uct, &pure_mcts, &settings);
+  PlayMatch(&alpha_beta, &uct, &settings);
 
+  alpha_beta.clear(&alpha_beta);
+  uct.clear(&uct);
   pure_mcts.clear(&pure_mcts);
   greedy.clear(&greedy);
   random.clear(&random);
 }
 
+// Usage: ./rev [weights_file]
+//
+// weights_file is a file written by ./train fit.
 int main(int argc, char **argv) {
   // scratchpad();
 
-  ai_stuff();
+  if (argc > 1) {
+    EvalWeights weights;
+    EvalWeightsInit(&weights);
+    if (!EvalLoadWeights(&weights, argv[1])) {
+      fprintf(stderr, "cannot load weights from %s\n", argv[1]);
+      return 1;
+    }
+    ai_stuff(&weights);
+    EvalWeightsFree(&weights);
+    return 0;
+  }
+  ai_stuff(NULL);
 }
@@ -0,0 +1,234 @@
+#ifndef REV_MATCH_H_
+#define REV_MATCH_H_
+
+#include "ai.h"
+#include "board.h"
+#include "explore.h"
+#include "list.h"
+#include "mtwister.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// A match compares two AIs with as few games as the result allows. Games
+// are played in pairs from the same opening, once with each AI as black,
+// which cancels most of the luck of the opening. After every round of pairs
+// a sequential probability ratio test (SPRT) decides whether the first AI is
+// at least elo1 stronger than the second, at most elo0, or whether more
+// games are needed.
+
+// Random plies (an even number, so black is to move) before each opening.
+#define MATCH_OPENING_TURNS 8
+// Pairs played between two checks of the test.
+#define MATCH_ROUND_PAIRS 16
+// z for a two-sided 95% confidence interval.
+#define MATCH_Z95 1.959964
+
+typedef enum {
+  MATCH_UNDECIDED,
+  // The first AI is at least elo1 stronger.
+  MATCH_ACCEPTED,
+  // The first AI is at most elo0 stronger.
+  MATCH_REJECTED
+} MatchDecision;
+
+typedef struct MatchSettings {
+  // Elo differences under the null and the alternative hypotheses.
+  double elo0;
+  double elo1;
+  // Chances of accepting when the difference is elo0, and of rejecting when
+  // it is elo1.
+  double alpha;
+  double beta;
+  // Give up undecided after this many pairs.
+  int max_pairs;
+  // Picks the openings and seeds the AIs; see PlayTournament().
+  uint64_t seed;
+} MatchSettings;
+
+MatchSettings MatchSettingsMake(int max_pairs, uint64_t seed) {
+  MatchSettings settings = {.elo0 = 0.0,
+                            .elo1 = 20.0,
+                            .alpha = 0.05,
+                            .beta = 0.05,
+                            .max_pairs = max_pairs,
+                            .seed = seed};
+  return settings;
+}
+
+// Counts are from the point of view of the first AI.
+typedef struct MatchResult {
+  int wins;
+  int losses;
+  int ties;
+  int pairs;
+  // Sum and sum of squares of the pair scores (0, 0.25, ..., 1).
+  double score_sum;
+  double score_squares;
+  // Log-likelihood ratio of the test so far.
+  double llr;
+  MatchDecision decision;
+} MatchResult;
+
+double p_EloToScore(double elo) { return 1.0 / (1.0 + pow(10.0, -elo / 400)); }
+
+double p_ScoreToElo(double score) {
+  // Keep a clean sweep finite.
+  const double epsilon = 1e-6;
+  score = fmin(fmax(score, epsilon), 1.0 - epsilon);
+  return -400.0 * log10(1.0 / score - 1.0);
+}
+
+double p_MatchScoreVariance(const MatchResult *result) {
+  double mean = result->score_sum / result->pairs;
+  return result->score_squares / result->pairs - mean * mean;
+}
+
+// Elo difference estimated from the mean pair score.
+double MatchElo(const MatchResult *result) {
+  return p_ScoreToElo(result->score_sum / result->pairs);
+}
+
+// Half width of the 95% confidence interval of MatchElo().
+double MatchEloError(const MatchResult *result) {
+  double mean = result->score_sum / result->pairs;
+  double margin =
+      MATCH_Z95 * sqrt(p_MatchScoreVariance(result) / result->pairs);
+  return (p_ScoreToElo(mean + margin) - p_ScoreToElo(mean - margin)) / 2;
+}
+
+// The log-likelihood ratio of elo1 against elo0, treating each pair score
+// as one normally distributed sample. Scoring pairs rather than games
+// accounts for the two games of a pair sharing an opening.
+double p_MatchLLR(const MatchResult *result, const MatchSettings *settings) {
+  double variance = p_MatchScoreVariance(result);
+  if (result->pairs < 2 || variance <= 0.0) {
+    return 0.0;
+  }
+  double s0 = p_EloToScore(settings->elo0);
+  double s1 = p_EloToScore(settings->elo1);
+  double mean = result->score_sum / result->pairs;
+  return result->pairs * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+// Fills openings with count positions, black to move, each after
+// MATCH_OPENING_TURNS random plies from the opening board.
+void p_MatchOpenings(Board *openings, int count, uint64_t seed) {
+  MTRand rng = seedRand(seed);
+  Board start = OpeningBoard();
+  int found = 0;
+  while (found < count) {
+    BoardList list = MakeBoardList();
+    SampleBoardsWithinDepthRange(&start, BLACKS_TURN, MATCH_OPENING_TURNS,
+                                 MATCH_OPENING_TURNS, &rng, count - found,
+                                 &list);
+    ResetBoardIter(&list);
+    Board *board;
+    while ((board = NextBoard(&list)) != NULL) {
+      // A sample cut short by a pass has the wrong side to move.
+      if (__builtin_popcountll(board->blacks | board->whites) ==
+              4 + MATCH_OPENING_TURNS &&
+          GenerateMoves(board, BLACKS_TURN) != 0) {
+        openings[found++] = *board;
+      }
+    }
+    BoardListClear(&list);
+  }
+}
+
+// Plays pairs of games between ai and opponent until the test decides or
+// settings->max_pairs pairs have been played. Like PlayTournament(), each
+// thread plays with its own copies of the AIs, seeded per game, so the
+// result only depends on settings->seed.
+MatchResult PlayMatch(AI *ai, AI *opponent, const MatchSettings *settings) {
+  printf("%s vs. %s  Match  |  ", AIName(ai), AIName(opponent));
+  fflush(stdout);
+
+  Board *openings = (Board *)malloc(settings->max_pairs * sizeof(Board));
+  p_MatchOpenings(openings, settings->max_pairs, settings->seed);
+  double lower = log(settings->beta / (1 - settings->alpha));
+  double upper = log((1 - settings->beta) / settings->alpha);
+
+  MatchResult result = {0};
+  result.decision = MATCH_UNDECIDED;
+  // Totals of the current round.
+  int wins;
+  int losses;
+  int ties;
+  double score_sum;
+  double score_squares;
+#pragma omp parallel
+  {
+    // Made once per thread, since an AI can be expensive to set up.
+    AI own = AIMakeSameTypeAs(ai);
+    AI other = AIMakeSameTypeAs(opponent);
+    while (result.decision == MATCH_UNDECIDED &&
+           result.pairs < settings->max_pairs) {
+      int first = result.pairs;
+      int last = first + MATCH_ROUND_PAIRS;
+      last = (last < settings->max_pairs) ? last : settings->max_pairs;
+#pragma omp single
+      {
+        wins = losses = ties = 0;
+        score_sum = score_squares = 0.0;
+      }
+#pragma omp for schedule(dynamic)                                             \
+    reduction(+ : wins, losses, ties, score_sum, score_squares)
+      for (int p = first; p < last; ++p) {
+        uint64_t pair_seed = settings->seed + (uint64_t)p * 0x9E3779B97F4A7C15;
+        int points = 0;
+        for (int g = 0; g < 2; ++g) {
+          AISeed(&own, p_SplitMix64(&pair_seed));
+          AISeed(&other, p_SplitMix64(&pair_seed));
+          AI *black = (g == 0) ? &own : &other;
+          AI *white = (g == 0) ? &other : &own;
+          Game game = PlayFrom(black, white, &openings[p], BLACKS_TURN);
+          GameResult won = (g == 0) ? GAME_BLACK_WON : GAME_WHITE_WON;
+          if (game.result == GAME_TIE) {
+            ties++;
+            points += 1;
+          } else if (game.result == won) {
+            wins++;
+            points += 2;
+          } else {
+            losses++;
+          }
+        }
+        double score = points / 4.0;
+        score_sum += score;
+        score_squares += score * score;
+      }
+#pragma omp single
+      {
+        result.wins += wins;
+        result.losses += losses;
+        result.ties += ties;
+        result.score_sum += score_sum;
+        result.score_squares += score_squares;
+        result.pairs = last;
+        result.llr = p_MatchLLR(&result, settings);
+        if (result.llr >= upper) {
+          result.decision = MATCH_ACCEPTED;
+        } else if (result.llr <= lower) {
+          result.decision = MATCH_REJECTED;
+        }
+      }
+    }
+    other.clear(&other);
+    own.clear(&own);
+  }
+  free(openings);
+
+  const char *verdicts[3] = {"undecided", "accepted", "rejected"};
+  printf("(win/loss/tie): (%d/%d/%d)  Elo %+.1f +- %.1f  "
+         "LLR %.2f [%.2f, %.2f]  %s after %d pairs (H1: %+.0f Elo)\n",
+         result.wins, result.losses, result.ties, MatchElo(&result),
+         MatchEloError(&result), result.llr, lower, upper,
+         verdicts[result.decision], result.pairs, settings->elo1);
+  return result;
+}
+
+#endif // REV_MATCH_H_
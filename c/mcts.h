@@ -0,0 +1,288 @@
+#ifndef REV_MCTS_H_
+#define REV_MCTS_H_
+
+#include "board.h"
+#include "playout.h"
+#include "timer.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UCT_EXPLORATION 0.7
+// Longest possible root-to-leaf path: 60 moves, each of which can follow a
+// pass.
+#define UCT_MAX_PATH 128
+// Iterations between clock reads in UCTSearchUntil().
+#define UCT_DEADLINE_CHECK_INTERVAL 16
+// Nodes reserved per playout. Each playout expands at most one node, which
+// adds one block of children (about ten on average).
+#define UCT_NODES_PER_PLAYOUT 12
+
+typedef enum { UCT_LEAF, UCT_EXPANDING, UCT_EXPANDED } UCTNodeState;
+
+// Several threads may search one tree at once. visits and wins are only
+// changed with atomic adds, and a node's children are published by storing
+// UCT_EXPANDED to state with release ordering after they are written.
+typedef struct UCTNode {
+  Board board;
+  // Index of the first child in the arena. Children are stored adjacently.
+  uint32_t first_child;
+  // Incremented on the way down, before the playout result is known. Until
+  // the result arrives this counts as a loss (a virtual loss), which steers
+  // other threads towards different paths.
+  uint32_t visits;
+  // Half-points (2 per win, 1 per tie) for the player who moved into this
+  // node, i.e. the player not to move here.
+  uint32_t wins;
+  uint8_t num_children;
+  uint8_t turn;
+  uint8_t state;
+} UCTNode;
+
+// All nodes of one search live in a single preallocated array. Expanding a
+// node bumps size by its number of children, so there is no per-node
+// allocation and siblings are contiguous.
+typedef struct UCTTree {
+  UCTNode *nodes;
+  uint32_t size;
+  uint32_t capacity;
+  // How the playouts from the leaves pick moves.
+  PlayoutPolicy policy;
+} UCTTree;
+
+void UCTTreeInit(UCTTree *tree, uint32_t capacity) {
+  tree->nodes = (UCTNode *)malloc(capacity * sizeof(UCTNode));
+  tree->size = 0;
+  tree->capacity = capacity;
+  tree->policy = PLAYOUT_UNIFORM;
+}
+
+void UCTTreeFree(UCTTree *tree) {
+  free(tree->nodes);
+  tree->nodes = NULL;
+  tree->size = 0;
+  tree->capacity = 0;
+}
+
+uint32_t UCTArenaCapacity(int num_playouts) {
+  return 1 + MAX_NUM_CHILD_BOARDS + UCT_NODES_PER_PLAYOUT * num_playouts;
+}
+
+void p_UCTInitNode(UCTNode *node, const Board *board, Turn turn) {
+  node->board = *board;
+  node->first_child = 0;
+  node->visits = 0;
+  node->wins = 0;
+  node->num_children = 0;
+  node->turn = turn;
+  node->state = UCT_LEAF;
+}
+
+// Makes node 0 the root, for board with turn to move, and choices (the
+// children of board) its children, in order.
+void UCTSetRoot(UCTTree *tree, const Board *board, Turn turn,
+                const ChildBoards *choices) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  UCTNode *root = &tree->nodes[0];
+  p_UCTInitNode(root, board, turn);
+  root->first_child = 1;
+  root->num_children = choices->count;
+  root->state = UCT_EXPANDED;
+  for (int i = 0; i < choices->count; ++i) {
+    p_UCTInitNode(&tree->nodes[1 + i], &choices->boards[i], next_turn);
+  }
+  tree->size = 1 + choices->count;
+}
+
+// Returns the number of nodes in the subtree under index.
+uint32_t p_UCTSubtreeSize(const UCTTree *tree, uint32_t index) {
+  uint32_t size = 1;
+  const UCTNode *node = &tree->nodes[index];
+  if (node->state == UCT_EXPANDED) {
+    for (uint32_t i = 0; i < node->num_children; ++i) {
+      size += p_UCTSubtreeSize(tree, node->first_child + i);
+    }
+  }
+  return size;
+}
+
+// Makes the node at index the root, dropping everything outside its
+// subtree. The subtree is copied breadth first into a fresh arena with room
+// for extra_capacity more nodes, so the root's children end up at 1, 2, ...
+// as after UCTSetRoot(). Must not run during a search, so a node still marked
+// UCT_EXPANDING was abandoned and goes back to being a leaf.
+void UCTTreeReroot(UCTTree *tree, uint32_t index, uint32_t extra_capacity) {
+  UCTTree fresh;
+  UCTTreeInit(&fresh, p_UCTSubtreeSize(tree, index) + extra_capacity);
+  fresh.policy = tree->policy;
+  fresh.nodes[0] = tree->nodes[index];
+  fresh.size = 1;
+  for (uint32_t i = 0; i < fresh.size; ++i) {
+    UCTNode *node = &fresh.nodes[i];
+    if (node->state != UCT_EXPANDED) {
+      node->state = UCT_LEAF;
+      continue;
+    }
+    memcpy(&fresh.nodes[fresh.size], &tree->nodes[node->first_child],
+           node->num_children * sizeof(UCTNode));
+    node->first_child = fresh.size;
+    fresh.size += node->num_children;
+  }
+  UCTTreeFree(tree);
+  *tree = fresh;
+}
+
+// Returns the index of an expanded child of the root for board with turn to
+// move, or -1. After rerooting at our move, this finds the position the
+// opponent's reply (or pass) led to.
+int64_t UCTFindPosition(const UCTTree *tree, const Board *board, Turn turn) {
+  const UCTNode *root = &tree->nodes[0];
+  if (root->state != UCT_EXPANDED) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < root->num_children; ++i) {
+    const UCTNode *node = &tree->nodes[root->first_child + i];
+    if (node->state == UCT_EXPANDED && node->turn == turn &&
+        node->board.blacks == board->blacks &&
+        node->board.whites == board->whites) {
+      return root->first_child + i;
+    }
+  }
+  return -1;
+}
+
+// Adds the children of a node. A player with no moves gets a single pass
+// child. Returns false if another thread got there first or the arena is
+// full.
+bool p_UCTExpand(UCTTree *tree, UCTNode *node) {
+  uint8_t expected = UCT_LEAF;
+  if (__atomic_load_n(&tree->size, __ATOMIC_RELAXED) + MAX_NUM_CHILD_BOARDS >
+          tree->capacity ||
+      !__atomic_compare_exchange_n(&node->state, &expected, UCT_EXPANDING,
+                                   false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  Turn turn = (Turn)node->turn;
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  ChildBoards children;
+  GenerateChildBoards(&node->board, turn, &children);
+  if (children.count == 0 && GenerateMoves(&node->board, next_turn) != 0) {
+    children.boards[0] = node->board;
+    children.count = 1;
+  }
+
+  uint32_t first =
+      __atomic_fetch_add(&tree->size, children.count, __ATOMIC_RELAXED);
+  if (first + children.count > tree->capacity) {
+    // Lost a race for the last slots. The node goes back to being a leaf,
+    // which a rerooted tree with room may expand later.
+    __atomic_store_n(&node->state, UCT_LEAF, __ATOMIC_RELAXED);
+    return false;
+  }
+  for (int i = 0; i < children.count; ++i) {
+    p_UCTInitNode(&tree->nodes[first + i], &children.boards[i], next_turn);
+  }
+  node->first_child = first;
+  node->num_children = children.count;
+  __atomic_store_n(&node->state, UCT_EXPANDED, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Returns the index of the child maximizing UCB1. Unvisited children go
+// first.
+uint32_t p_UCTSelectChild(UCTTree *tree, UCTNode *node) {
+  double log_visits =
+      log((double)__atomic_load_n(&node->visits, __ATOMIC_RELAXED));
+  uint32_t best = node->first_child;
+  double best_score = -1.0;
+  for (uint32_t i = node->first_child;
+       i < node->first_child + node->num_children; ++i) {
+    UCTNode *child = &tree->nodes[i];
+    uint32_t visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+    uint32_t wins = __atomic_load_n(&child->wins, __ATOMIC_RELAXED);
+    if (visits == 0) {
+      return i;
+    }
+    double score = wins / (2.0 * visits) +
+                   UCT_EXPLORATION * sqrt(log_visits / visits);
+    if (score > best_score) {
+      best_score = score;
+      best = i;
+    }
+  }
+  return best;
+}
+
+// One selection, expansion, simulation and backpropagation pass.
+void UCTIterate(UCTTree *tree, PlayoutRng *rng) {
+  uint32_t path[UCT_MAX_PATH];
+  int length = 0;
+
+  uint32_t index = 0;
+  uint32_t visits = __atomic_add_fetch(&tree->nodes[0].visits, 1,
+                                       __ATOMIC_RELAXED);
+  path[length++] = index;
+  while (true) {
+    UCTNode *node = &tree->nodes[index];
+    if (__atomic_load_n(&node->state, __ATOMIC_ACQUIRE) != UCT_EXPANDED) {
+      // Expand on the second visit, so one-off leaves cost no arena space.
+      // A node being expanded by another thread is treated as a leaf.
+      if (visits < 2 || !p_UCTExpand(tree, node)) {
+        break;
+      }
+    }
+    if (node->num_children == 0) {
+      break;
+    }
+    index = p_UCTSelectChild(tree, node);
+    visits = __atomic_add_fetch(&tree->nodes[index].visits, 1,
+                                __ATOMIC_RELAXED);
+    path[length++] = index;
+  }
+
+  UCTNode *leaf = &tree->nodes[index];
+  int difference =
+      Playout(&leaf->board, (Turn)leaf->turn, tree->policy, rng);
+
+  for (int i = 0; i < length; ++i) {
+    UCTNode *node = &tree->nodes[path[i]];
+    bool black_moved_here = node->turn == WHITES_TURN;
+    if (difference == 0) {
+      __atomic_fetch_add(&node->wins, 1, __ATOMIC_RELAXED);
+    } else if ((difference > 0) == black_moved_here) {
+      __atomic_fetch_add(&node->wins, 2, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Runs num_playouts iterations split across num_threads threads that all
+// descend the same tree. Thread i draws from rngs[i].
+void UCTSearch(UCTTree *tree, int num_playouts, int num_threads,
+               PlayoutRng *rngs) {
+#pragma omp parallel for schedule(dynamic, 8) num_threads(num_threads)
+  for (int i = 0; i < num_playouts; ++i) {
+    UCTIterate(tree, &rngs[omp_get_thread_num()]);
+  }
+}
+
+// Like UCTSearch(), but iterates until deadline (a ClockNow() time). Once the
+// arena is full, leaves are no longer expanded but playouts continue.
+void UCTSearchUntil(UCTTree *tree, double deadline, int num_threads,
+                    PlayoutRng *rngs) {
+#pragma omp parallel num_threads(num_threads)
+  {
+    Deadline clock = DeadlineMake(deadline, UCT_DEADLINE_CHECK_INTERVAL);
+    PlayoutRng *rng = &rngs[omp_get_thread_num()];
+    do {
+      UCTIterate(tree, rng);
+    } while (!DeadlinePassed(&clock));
+  }
+}
+
+#endif // REV_MCTS_H_
@@ -0,0 +1,258 @@
+// Move-generation benchmark and regression check. Walks the full game tree
+// from OpeningBoard() (with and without canonical dedup of siblings), checks
+// the leaf counts against reference values, and reports leaves/sec for each
+// thread count. Also checks that each batch playout kernel plays exactly
+// the number of games asked for, and that the canonical children hashed
+// from their parent's Zobrist lanes have the hashes of their boards.
+//
+// Usage: ./perft [max_depth] [max_threads]
+
+#include "board.h"
+#include "explore.h"
+#include "playout.h"
+#include "zobrist.h"
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <omp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PERFT_MAX_DEPTH 14
+#define PERFT_SPLIT_DEPTH 5
+// Depth of the canonical tree CheckHashedChildren() walks.
+#define PERFT_HASH_CHECK_DEPTH 8
+
+// Published Othello perft counts (passes count as a ply).
+const uint64_t PERFT_COUNTS[PERFT_MAX_DEPTH + 1] = {
+    1,          4,           12,           56,           244,
+    1396,       8200,        55092,        390216,       3005288,
+    24571284,   212258800,   1939886636,   18429641748,  184042084512};
+
+// Counts for the canonical tree, recorded from the original scalar
+// implementation of GenerateCanonicalChildBoards. Zero means unknown.
+const uint64_t CANONICAL_PERFT_COUNTS[PERFT_MAX_DEPTH + 1] = {
+    1,          1,           3,            14,           60,
+    336,        1969,        13169,        93093,        714850,
+    5836537,    50327080,    459595050,    0,            0};
+
+typedef struct PerftTask {
+  Board board;
+  Turn turn;
+} PerftTask;
+
+typedef struct PerftTasks {
+  PerftTask *tasks;
+  int count;
+  int capacity;
+  uint64_t leaves;
+} PerftTasks;
+
+void AddPerftTask(PerftTasks *tasks, const Board *board, Turn turn) {
+  if (tasks->count == tasks->capacity) {
+    tasks->capacity = (tasks->capacity == 0) ? 1024 : 2 * tasks->capacity;
+    tasks->tasks = (PerftTask *)realloc(tasks->tasks,
+                                        tasks->capacity * sizeof(PerftTask));
+  }
+  tasks->tasks[tasks->count].board = *board;
+  tasks->tasks[tasks->count].turn = turn;
+  tasks->count++;
+}
+
+// Collects the nodes num_turns plies below board, following the same rules
+// as Perft(). Games that end before then are counted in tasks->leaves.
+void CollectPerftTasks(Board *board, Turn turn, int num_turns, bool canonical,
+                       PerftTasks *tasks) {
+  if (num_turns == 0) {
+    AddPerftTask(tasks, board, turn);
+    return;
+  }
+
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  ChildBoards children;
+  m_GenerateChildBoards(board, turn, &children, canonical);
+  if (children.count == 0) {
+    if (GenerateMoves(board, next_turn) == 0) {
+      tasks->leaves++;
+    } else {
+      CollectPerftTasks(board, next_turn, num_turns - 1, canonical, tasks);
+    }
+    return;
+  }
+  for (int i = 0; i < children.count; ++i) {
+    CollectPerftTasks(&children.boards[i], next_turn, num_turns - 1,
+                      canonical, tasks);
+  }
+}
+
+uint64_t ParallelPerft(int depth, bool canonical, int num_threads) {
+  Board opening_board = OpeningBoard();
+  if (depth <= PERFT_SPLIT_DEPTH) {
+    return Perft(&opening_board, BLACKS_TURN, depth, canonical);
+  }
+
+  PerftTasks tasks = {.tasks = NULL, .count = 0, .capacity = 0, .leaves = 0};
+  CollectPerftTasks(&opening_board, BLACKS_TURN, PERFT_SPLIT_DEPTH, canonical,
+                    &tasks);
+
+  uint64_t leaves = tasks.leaves;
+#pragma omp parallel for schedule(dynamic) reduction(+ : leaves)               \
+    num_threads(num_threads)
+  for (int i = 0; i < tasks.count; ++i) {
+    leaves += Perft(&tasks.tasks[i].board, tasks.tasks[i].turn,
+                    depth - PERFT_SPLIT_DEPTH, canonical);
+  }
+
+  free(tasks.tasks);
+  return leaves;
+}
+
+// Runs one perft and prints a line for it. Returns false on a count mismatch.
+bool CheckPerft(int depth, bool canonical, int num_threads) {
+  const uint64_t *expected =
+      canonical ? CANONICAL_PERFT_COUNTS : PERFT_COUNTS;
+
+  double t0 = omp_get_wtime();
+  uint64_t leaves = ParallelPerft(depth, canonical, num_threads);
+  double seconds = omp_get_wtime() - t0;
+
+  const char *status = "";
+  bool ok = true;
+  if (depth <= PERFT_MAX_DEPTH && expected[depth] != 0) {
+    ok = leaves == expected[depth];
+    status = ok ? "ok" : "MISMATCH";
+  }
+  printf("%-9s depth %2d: %15" PRIu64 " leaves %9.3fs %10.2f M/s  %s\n",
+         canonical ? "canonical" : "full", depth, leaves, seconds,
+         leaves / seconds / 1e6, status);
+  if (!ok) {
+    printf("    expected %" PRIu64 "\n", expected[depth]);
+  }
+  return ok;
+}
+
+// Plays 1 to 2 * num_lanes games with kernel from a finished position, where
+// every game is a win worth 2 half-points, and checks the total against
+// PlayoutBatchScalar(). Returns false on a mismatch.
+bool CheckPlayoutBatch(const char *name, PlayoutBatchKernel *kernel,
+                       int num_lanes) {
+  // Black to move with no discs of its own: neither side can move, and the
+  // player who moved into the position (white) has won.
+  Board finished = {.blacks = 0, .whites = OpeningBoard().whites};
+  PlayoutRng rng = PlayoutRngMake(1);
+  bool ok = true;
+  for (int n = 1; n <= 2 * num_lanes; ++n) {
+    int expected =
+        PlayoutBatchScalar(&finished, BLACKS_TURN, n, PLAYOUT_UNIFORM, &rng);
+    int points = kernel(&finished, BLACKS_TURN, n, PLAYOUT_UNIFORM, &rng);
+    if (points != expected) {
+      printf("playout %s: %d games scored %d half-points, expected %d  "
+             "MISMATCH\n",
+             name, n, points, expected);
+      ok = false;
+    }
+  }
+  if (ok) {
+    printf("playout %s: 1 to %d games  ok\n", name, 2 * num_lanes);
+  }
+  return ok;
+}
+
+// Walks the canonical tree num_turns plies deep and checks, at every node,
+// that GenerateCanonicalChildBoardsHashed() gives the children of
+// GenerateCanonicalChildBoards(), in order, each with its ZobristHash().
+// Counts the children checked in num_children and returns the number that
+// were wrong.
+uint64_t CheckHashedChildren(Board *board, Turn turn, int num_turns,
+                             uint64_t *num_children) {
+  if (num_turns == 0) {
+    return 0;
+  }
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  ChildBoards children;
+  GenerateCanonicalChildBoards(board, turn, &children);
+  if (children.count == 0) {
+    if (GenerateMoves(board, next_turn) == 0) {
+      return 0;
+    }
+    return CheckHashedChildren(board, next_turn, num_turns - 1,
+                               num_children);
+  }
+
+  ZobristLanes lanes;
+  ZobristLanesOf(board, &lanes);
+  ChildBoards hashed;
+  uint64_t hashes[MAX_NUM_CHILD_BOARDS];
+  GenerateCanonicalChildBoardsHashed(board, turn, &lanes, &hashed, hashes);
+
+  uint64_t num_bad = (hashed.count != children.count) ? 1 : 0;
+  for (int i = 0; i < children.count && num_bad == 0; ++i) {
+    num_bad += !BoardsEqual(&hashed.boards[i], &children.boards[i]) ||
+               hashes[i] != ZobristHash(&children.boards[i]);
+  }
+  *num_children += children.count;
+  for (int i = 0; i < children.count; ++i) {
+    num_bad += CheckHashedChildren(&children.boards[i], next_turn,
+                                   num_turns - 1, num_children);
+  }
+  return num_bad;
+}
+
+int main(int argc, char **argv) {
+  int max_depth = (argc > 1) ? atoi(argv[1]) : 10;
+  int max_threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+
+#ifdef REV_AVX2_MOVEGEN
+  printf("move generator: avx2  ");
+#else
+  printf("move generator: scalar  ");
+#endif
+  printf("rotate kernel: %s\n", RotateKernelName());
+
+  bool ok = true;
+#ifdef REV_AVX2_MOVEGEN
+  ok = CheckPlayoutBatch("avx2", PlayoutBatchAVX2, 4) && ok;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    ok = CheckPlayoutBatch("avx512", PlayoutBatchAVX512, 8) && ok;
+  }
+#endif
+  Board opening_board = OpeningBoard();
+  uint64_t num_children = 0;
+  uint64_t num_bad = CheckHashedChildren(
+      &opening_board, BLACKS_TURN, PERFT_HASH_CHECK_DEPTH, &num_children);
+  printf("hashed canonical children: %" PRIu64 " checked  %s\n",
+         num_children, (num_bad == 0) ? "ok" : "MISMATCH");
+  ok = ok && num_bad == 0;
+  for (int canonical = 0; canonical < 2; ++canonical) {
+    for (int depth = 1; depth <= max_depth; ++depth) {
+      ok = CheckPerft(depth, canonical, max_threads) && ok;
+    }
+  }
+
+  printf("\nScaling at depth %d:\n", max_depth);
+  double base_seconds = 0.0;
+  // Doubles the thread count, and runs max_threads last if it is not a power
+  // of two.
+  for (int threads = 1; threads <= max_threads;
+       threads = (threads < max_threads && 2 * threads > max_threads)
+                     ? max_threads
+                     : 2 * threads) {
+    double t0 = omp_get_wtime();
+    uint64_t leaves = ParallelPerft(max_depth, false, threads);
+    double seconds = omp_get_wtime() - t0;
+    if (threads == 1) {
+      base_seconds = seconds;
+    }
+    printf("%3d threads: %10.2f M leaves/s  speedup %.2fx\n", threads,
+           leaves / seconds / 1e6, base_seconds / seconds);
+  }
+
+  if (!ok) {
+    printf("\nperft FAILED\n");
+    return 1;
+  }
+  return 0;
+}
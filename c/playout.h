@@ -0,0 +1,579 @@
+#ifndef REV_PLAYOUT_H_
+#define REV_PLAYOUT_H_
+
+#include "board.h"
+
+#include <fcntl.h>
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+// Random playouts are the inner loop of the MCTS AIs, so they get their own
+// path: no game record, no AI callbacks and a generator with 32 bytes of
+// state instead of the Mersenne Twister's 2.5 KB.
+
+// xoshiro256** (Blackman and Vigna). Each thread needs its own.
+typedef struct PlayoutRng {
+  uint64_t s[4];
+} PlayoutRng;
+
+// Expands a seed into a full state, as the xoshiro authors recommend.
+uint64_t p_SplitMix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9E3779B97F4A7C15);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+  return z ^ (z >> 31);
+}
+
+PlayoutRng PlayoutRngMake(uint64_t seed) {
+  PlayoutRng rng;
+  for (int i = 0; i < 4; ++i) {
+    rng.s[i] = p_SplitMix64(&seed);
+  }
+  return rng;
+}
+
+PlayoutRng PlayoutRngSystemSeed() {
+  uint64_t seed;
+  int fd = open("/dev/urandom", O_RDONLY);
+  if (fd < 0 || read(fd, &seed, sizeof(seed)) != sizeof(seed)) {
+    exit(1);
+  }
+  close(fd);
+  return PlayoutRngMake(seed);
+}
+
+uint64_t PlayoutRngNext(PlayoutRng *rng) {
+  uint64_t *s = rng->s;
+  uint64_t x = s[1] * 5;
+  uint64_t result = ((x << 7) | (x >> 57)) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+  return result;
+}
+
+// A number in [0, n) from the top 32 bits, by multiplying instead of a
+// division. The bias is below 2^-26 for the n <= 64 used here.
+uint32_t PlayoutRandomBelow(PlayoutRng *rng, uint32_t n) {
+  return (uint32_t)(((PlayoutRngNext(rng) >> 32) * n) >> 32);
+}
+
+// How a playout picks its moves. Heavy playouts play corners more often and
+// the X- and C-squares next to empty corners less often, which makes their
+// results more like those of real games at little extra cost per move.
+typedef enum PlayoutPolicy { PLAYOUT_UNIFORM, PLAYOUT_HEAVY } PlayoutPolicy;
+
+// Relative chances of each kind of move in a heavy playout.
+#define PLAYOUT_CORNER_WEIGHT 16
+#define PLAYOUT_PLAIN_WEIGHT 4
+#define PLAYOUT_DANGER_WEIGHT 1
+
+// X- and C-squares (next to a corner) whose corner is among empties.
+uint64_t p_DangerSquares(uint64_t empties) {
+  uint64_t corners = CORNERS & empties;
+  // Square 0 is the bottom right corner (see rcol).
+  uint64_t right = corners & 0x0100000000000001;
+  uint64_t left = corners & 0x8000000000000080;
+  uint64_t bottom = corners & 0x0000000000000081;
+  uint64_t top = corners & 0x8100000000000000;
+  return (right << 1) | (left >> 1) | (bottom << 8) | (top >> 8) |
+         ((corners & 0x0000000000000001) << 9) |
+         ((corners & 0x0000000000000080) << 7) |
+         ((corners & 0x0100000000000000) >> 7) |
+         ((corners & 0x8000000000000000) >> 9);
+}
+
+// Draws a move from moves (with empties the empty squares) under policy.
+// Returns the moves of the drawn move's kind and sets n to the drawn move's
+// index among them, so weighting costs a few popcounts and no loop.
+uint64_t p_DrawMove(uint64_t moves, uint64_t empties, PlayoutPolicy policy,
+                    PlayoutRng *rng, uint32_t *n) {
+  if (policy == PLAYOUT_UNIFORM) {
+    *n = PlayoutRandomBelow(rng, __builtin_popcountll(moves));
+    return moves;
+  }
+  uint64_t corners = moves & CORNERS;
+  uint64_t danger = moves & p_DangerSquares(empties);
+  uint64_t plain = moves & ~(corners | danger);
+  uint32_t corner_total = PLAYOUT_CORNER_WEIGHT * __builtin_popcountll(corners);
+  uint32_t plain_total = PLAYOUT_PLAIN_WEIGHT * __builtin_popcountll(plain);
+  uint32_t total = corner_total + plain_total +
+                   PLAYOUT_DANGER_WEIGHT * __builtin_popcountll(danger);
+  uint32_t r = PlayoutRandomBelow(rng, total);
+  if (r < corner_total) {
+    *n = r / PLAYOUT_CORNER_WEIGHT;
+    return corners;
+  }
+  r -= corner_total;
+  if (r < plain_total) {
+    *n = r / PLAYOUT_PLAIN_WEIGHT;
+    return plain;
+  }
+  *n = (r - plain_total) / PLAYOUT_DANGER_WEIGHT;
+  return danger;
+}
+
+// Playout kernels. Picking the n-th move is a single PDEP where that is
+// fast; elsewhere (microcoded PDEP, or none) the lowest moves are cleared
+// one at a time. One kernel is chosen at startup, like the rotation kernels
+// in board.h.
+typedef int PlayoutKernel(Board board, Turn turn, PlayoutPolicy policy,
+                          PlayoutRng *rng);
+
+// NthSetBit() with a single PDEP.
+__attribute__((target("bmi2"))) int p_NthSetBitPdep(uint64_t x, uint32_t n) {
+  return __builtin_ctzll(_pdep_u64(1ULL << n, x));
+}
+
+// Plays uniformly random moves to the end of the game. Returns the number of
+// black pieces minus the number of white pieces.
+__attribute__((target("bmi2"))) int
+PlayoutPdep(Board board, Turn turn, PlayoutPolicy policy, PlayoutRng *rng) {
+  while (true) {
+    uint64_t moves = GenerateMoves(&board, turn);
+    if (moves == 0) {
+      turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+      moves = GenerateMoves(&board, turn);
+      if (moves == 0) {
+        break;
+      }
+    }
+    uint32_t n;
+    moves = p_DrawMove(moves, EmptySquares(&board), policy, rng, &n);
+    int square = p_NthSetBitPdep(moves, n);
+    ApplyMove(&board, turn, square, ComputeFlips(&board, turn, square));
+    turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  }
+  return __builtin_popcountll(board.blacks) -
+         __builtin_popcountll(board.whites);
+}
+
+int PlayoutScalar(Board board, Turn turn, PlayoutPolicy policy,
+                  PlayoutRng *rng) {
+  while (true) {
+    uint64_t moves = GenerateMoves(&board, turn);
+    if (moves == 0) {
+      turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+      moves = GenerateMoves(&board, turn);
+      if (moves == 0) {
+        break;
+      }
+    }
+    uint32_t n;
+    moves = p_DrawMove(moves, EmptySquares(&board), policy, rng, &n);
+    int square = NthSetBit(moves, n);
+    ApplyMove(&board, turn, square, ComputeFlips(&board, turn, square));
+    turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  }
+  return __builtin_popcountll(board.blacks) -
+         __builtin_popcountll(board.whites);
+}
+
+PlayoutKernel *PLAYOUT_KERNEL = PlayoutScalar;
+
+// Returns the best cycles for a batch of playouts from the opening.
+uint64_t p_ProbePlayoutKernel(PlayoutKernel *kernel) {
+  const int num_playouts = 16;
+  Board opening = OpeningBoard();
+  uint64_t best = UINT64_MAX;
+  for (int trial = 0; trial < 3; ++trial) {
+    // The same games for every kernel.
+    PlayoutRng rng = PlayoutRngMake(trial);
+    int sum = 0;
+    uint64_t t0 = __rdtsc();
+    for (int i = 0; i < num_playouts; ++i) {
+      sum += kernel(opening, BLACKS_TURN, PLAYOUT_UNIFORM, &rng);
+    }
+    uint64_t t1 = __rdtsc();
+    __asm__ volatile("" : : "r"(sum));
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+    }
+  }
+  return best;
+}
+
+__attribute__((constructor)) void p_SelectPlayoutKernel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("bmi2") &&
+      p_ProbePlayoutKernel(PlayoutPdep) <
+          p_ProbePlayoutKernel(PlayoutScalar)) {
+    PLAYOUT_KERNEL = PlayoutPdep;
+  }
+}
+
+const char *PlayoutKernelName() {
+  return (PLAYOUT_KERNEL == PlayoutPdep) ? "pdep" : "scalar";
+}
+
+// Plays a random game from board with turn to move. Returns the number of
+// black pieces minus the number of white pieces at the end.
+int Playout(const Board *board, Turn turn, PlayoutPolicy policy,
+            PlayoutRng *rng) {
+  return PLAYOUT_KERNEL(*board, turn, policy, rng);
+}
+
+// Lockstep playouts. One random game is a chain of dependent, branchy
+// steps, so PlayoutBatch() instead advances several independent games
+// together, one per 64-bit vector lane, and gives a lane the next game as
+// soon as its game ends. Moves and flips for all lanes come from the same
+// vector instructions; only picking each lane's random move is scalar. There
+// are 8 lanes with AVX-512 and 4 with AVX2, chosen at startup.
+#define PLAYOUT_MAX_LANES 8
+
+// Half-points for mover from a game that ended with difference (black minus
+// white pieces).
+int p_PlayoutPoints(int difference, Turn mover) {
+  if (difference == 0) {
+    return 1;
+  }
+  return ((difference > 0) == (mover == BLACKS_TURN)) ? 2 : 0;
+}
+
+// Replaces each nonzero move mask with one of its bits, drawn under policy.
+// empties is only read by heavy playouts.
+void p_PickMoves(uint64_t *moves, const uint64_t *empties, int num_lanes,
+                 PlayoutPolicy policy, PlayoutRng *rng) {
+  bool use_pdep = PLAYOUT_KERNEL == PlayoutPdep;
+  for (int i = 0; i < num_lanes; ++i) {
+    if (moves[i] != 0) {
+      uint32_t n;
+      uint64_t lane = p_DrawMove(moves[i], empties[i], policy, rng, &n);
+      moves[i] =
+          1ULL << (use_pdep ? p_NthSetBitPdep(lane, n) : NthSetBit(lane, n));
+    }
+  }
+}
+
+// The lanes of a batch, for the scalar parts: the pieces of the side to
+// move and of the other side, whether the side to move is black, and whether
+// the lane is playing a game.
+typedef struct PlayoutLanes {
+  uint64_t own[PLAYOUT_MAX_LANES];
+  uint64_t opp[PLAYOUT_MAX_LANES];
+  uint64_t black[PLAYOUT_MAX_LANES];
+  uint64_t active[PLAYOUT_MAX_LANES];
+  // Games started so far, out of num_playouts.
+  int started;
+  int num_playouts;
+  uint64_t start_own;
+  uint64_t start_opp;
+  uint64_t start_black;
+} PlayoutLanes;
+
+// Starts the next game in lane i, or idles the lane if all have started.
+void p_RestartLane(PlayoutLanes *lanes, int i) {
+  bool restart = lanes->started < lanes->num_playouts;
+  lanes->started += restart;
+  lanes->own[i] = restart ? lanes->start_own : 0;
+  lanes->opp[i] = restart ? lanes->start_opp : 0;
+  lanes->black[i] = lanes->start_black;
+  lanes->active[i] = restart ? ~0ULL : 0;
+}
+
+// Starts the first games in lanes 0 to num_lanes - 1 and idles the rest.
+void p_InitLanes(PlayoutLanes *lanes, const Board *board, Turn turn,
+                 int num_playouts, int num_lanes) {
+  lanes->started = 0;
+  lanes->num_playouts = num_playouts;
+  lanes->start_own = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  lanes->start_opp = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+  lanes->start_black = (turn == BLACKS_TURN) ? ~0ULL : 0;
+  for (int i = 0; i < PLAYOUT_MAX_LANES; ++i) {
+    if (i < num_lanes) {
+      p_RestartLane(lanes, i);
+    } else {
+      lanes->own[i] = lanes->opp[i] = lanes->black[i] = lanes->active[i] = 0;
+    }
+  }
+}
+
+// Scores the lanes set in over and restarts them.
+int p_FinishLanes(PlayoutLanes *lanes, uint32_t over, Turn mover) {
+  int points = 0;
+  while (over != 0) {
+    int i = __builtin_ctz(over);
+    over = over & (over - 1);
+    uint64_t blacks = lanes->black[i] ? lanes->own[i] : lanes->opp[i];
+    uint64_t whites = lanes->black[i] ? lanes->opp[i] : lanes->own[i];
+    points += p_PlayoutPoints(
+        __builtin_popcountll(blacks) - __builtin_popcountll(whites), mover);
+    p_RestartLane(lanes, i);
+  }
+  return points;
+}
+
+// The eight directions as in ComputeFlipsScalar(), with the masks that drop
+// pieces that wrapped around an edge.
+const int PLAYOUT_SHIFTS[8] = {-8, 8, -1, 1, -7, -9, 9, 7};
+
+uint64_t p_PlayoutMask(int d) {
+  const uint64_t masks[8] = {~0ULL,    ~0ULL,    not_lcol, not_rcol,
+                             not_rcol, not_lcol, not_rcol, not_lcol};
+  return masks[d];
+}
+
+typedef int PlayoutBatchKernel(const Board *board, Turn turn,
+                               int num_playouts, PlayoutPolicy policy,
+                               PlayoutRng *rng);
+
+#ifdef REV_AVX2_MOVEGEN
+__m256i p_Shift4(__m256i x, int shift) {
+  return (shift > 0) ? _mm256_slli_epi64(x, shift)
+                     : _mm256_srli_epi64(x, -shift);
+}
+
+// Kogge-Stone occluded fill of gen through pro in each lane, along one
+// direction. pro must already be masked for wraparound.
+__m256i p_Fill4(__m256i gen, __m256i pro, int shift) {
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, p_Shift4(gen, shift)));
+  pro = _mm256_and_si256(pro, p_Shift4(pro, shift));
+  gen = _mm256_or_si256(gen, _mm256_and_si256(pro, p_Shift4(gen, 2 * shift)));
+  pro = _mm256_and_si256(pro, p_Shift4(pro, 2 * shift));
+  return _mm256_or_si256(gen,
+                         _mm256_and_si256(pro, p_Shift4(gen, 4 * shift)));
+}
+
+// GenerateMoves() for own to move in each lane.
+__m256i p_Moves4(__m256i own, __m256i opp) {
+  __m256i moves = _mm256_setzero_si256();
+  for (int d = 0; d < 8; ++d) {
+    __m256i mask = _mm256_set1_epi64x(p_PlayoutMask(d));
+    __m256i gen = p_Fill4(own, _mm256_and_si256(opp, mask), PLAYOUT_SHIFTS[d]);
+    gen = p_Shift4(_mm256_xor_si256(gen, own), PLAYOUT_SHIFTS[d]);
+    moves = _mm256_or_si256(moves, _mm256_and_si256(mask, gen));
+  }
+  return _mm256_andnot_si256(_mm256_or_si256(own, opp), moves);
+}
+
+// ComputeFlips() for own playing the single bit mv in each lane. Lanes where
+// mv is zero flip nothing.
+__m256i p_Flips4(__m256i own, __m256i opp, __m256i mv) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i flips = zero;
+  for (int d = 0; d < 8; ++d) {
+    __m256i mask = _mm256_set1_epi64x(p_PlayoutMask(d));
+    __m256i gen = p_Fill4(mv, _mm256_and_si256(opp, mask), PLAYOUT_SHIFTS[d]);
+    // A run only flips if the square just past it holds one of our pieces.
+    __m256i end = _mm256_and_si256(mask, p_Shift4(gen, PLAYOUT_SHIFTS[d]));
+    __m256i open = _mm256_cmpeq_epi64(_mm256_and_si256(own, end), zero);
+    flips = _mm256_or_si256(
+        flips, _mm256_andnot_si256(open, _mm256_xor_si256(gen, mv)));
+  }
+  return flips;
+}
+
+// Swaps a and b in the lanes set in which.
+void p_SwapLanes4(__m256i *a, __m256i *b, __m256i which) {
+  __m256i t = *a;
+  *a = _mm256_blendv_epi8(*a, *b, which);
+  *b = _mm256_blendv_epi8(*b, t, which);
+}
+
+int PlayoutBatchAVX2(const Board *board, Turn turn, int num_playouts,
+                     PlayoutPolicy policy, PlayoutRng *rng) {
+  Turn mover = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  PlayoutLanes lanes;
+  p_InitLanes(&lanes, board, turn, num_playouts, 4);
+  __m256i own = _mm256_loadu_si256((const __m256i *)lanes.own);
+  __m256i opp = _mm256_loadu_si256((const __m256i *)lanes.opp);
+  __m256i black = _mm256_loadu_si256((const __m256i *)lanes.black);
+  __m256i active = _mm256_loadu_si256((const __m256i *)lanes.active);
+  __m256i zero = _mm256_setzero_si256();
+
+  int points = 0;
+  while (!_mm256_testz_si256(active, active)) {
+    __m256i moves = p_Moves4(own, opp);
+    __m256i stuck = _mm256_and_si256(active, _mm256_cmpeq_epi64(moves, zero));
+    if (!_mm256_testz_si256(stuck, stuck)) {
+      // Pass in those lanes. If the other side cannot move either, the game
+      // is over.
+      p_SwapLanes4(&own, &opp, stuck);
+      black = _mm256_xor_si256(black, stuck);
+      moves = _mm256_blendv_epi8(moves, p_Moves4(own, opp), stuck);
+      __m256i over = _mm256_and_si256(stuck, _mm256_cmpeq_epi64(moves, zero));
+      if (!_mm256_testz_si256(over, over)) {
+        _mm256_storeu_si256((__m256i *)lanes.own, own);
+        _mm256_storeu_si256((__m256i *)lanes.opp, opp);
+        _mm256_storeu_si256((__m256i *)lanes.black, black);
+        _mm256_storeu_si256((__m256i *)lanes.active, active);
+        uint32_t over_bits = _mm256_movemask_pd(_mm256_castsi256_pd(over));
+        points += p_FinishLanes(&lanes, over_bits, mover);
+        // Restarted lanes move from the next step on.
+        own = _mm256_loadu_si256((const __m256i *)lanes.own);
+        opp = _mm256_loadu_si256((const __m256i *)lanes.opp);
+        black = _mm256_loadu_si256((const __m256i *)lanes.black);
+        active = _mm256_loadu_si256((const __m256i *)lanes.active);
+        moves = _mm256_andnot_si256(over, moves);
+      }
+    }
+
+    uint64_t move_lanes[4];
+    uint64_t empty_lanes[4];
+    _mm256_storeu_si256((__m256i *)move_lanes, moves);
+    if (policy != PLAYOUT_UNIFORM) {
+      _mm256_storeu_si256((__m256i *)empty_lanes,
+                          _mm256_xor_si256(_mm256_or_si256(own, opp),
+                                           _mm256_set1_epi64x(-1)));
+    }
+    p_PickMoves(move_lanes, empty_lanes, 4, policy, rng);
+    __m256i mv = _mm256_loadu_si256((const __m256i *)move_lanes);
+    __m256i flips = p_Flips4(own, opp, mv);
+    own = _mm256_or_si256(own, _mm256_or_si256(flips, mv));
+    opp = _mm256_andnot_si256(flips, opp);
+    // Hand the turn over in the lanes that moved.
+    __m256i moved = _mm256_xor_si256(_mm256_cmpeq_epi64(mv, zero),
+                                     _mm256_set1_epi64x(-1));
+    p_SwapLanes4(&own, &opp, moved);
+    black = _mm256_xor_si256(black, moved);
+  }
+  return points;
+}
+
+// The same with eight lanes and mask registers.
+__attribute__((target("avx512f"))) __m512i p_Shift8(__m512i x, int shift) {
+  return (shift > 0) ? _mm512_slli_epi64(x, shift)
+                     : _mm512_srli_epi64(x, -shift);
+}
+
+__attribute__((target("avx512f"))) __m512i p_Fill8(__m512i gen, __m512i pro,
+                                                   int shift) {
+  gen = _mm512_or_si512(gen, _mm512_and_si512(pro, p_Shift8(gen, shift)));
+  pro = _mm512_and_si512(pro, p_Shift8(pro, shift));
+  gen = _mm512_or_si512(gen, _mm512_and_si512(pro, p_Shift8(gen, 2 * shift)));
+  pro = _mm512_and_si512(pro, p_Shift8(pro, 2 * shift));
+  return _mm512_or_si512(gen,
+                         _mm512_and_si512(pro, p_Shift8(gen, 4 * shift)));
+}
+
+__attribute__((target("avx512f"))) __m512i p_Moves8(__m512i own, __m512i opp) {
+  __m512i moves = _mm512_setzero_si512();
+  for (int d = 0; d < 8; ++d) {
+    __m512i mask = _mm512_set1_epi64(p_PlayoutMask(d));
+    __m512i gen = p_Fill8(own, _mm512_and_si512(opp, mask), PLAYOUT_SHIFTS[d]);
+    gen = p_Shift8(_mm512_xor_si512(gen, own), PLAYOUT_SHIFTS[d]);
+    moves = _mm512_or_si512(moves, _mm512_and_si512(mask, gen));
+  }
+  return _mm512_andnot_si512(_mm512_or_si512(own, opp), moves);
+}
+
+__attribute__((target("avx512f"))) __m512i p_Flips8(__m512i own, __m512i opp,
+                                                    __m512i mv) {
+  __m512i flips = _mm512_setzero_si512();
+  for (int d = 0; d < 8; ++d) {
+    __m512i mask = _mm512_set1_epi64(p_PlayoutMask(d));
+    __m512i gen = p_Fill8(mv, _mm512_and_si512(opp, mask), PLAYOUT_SHIFTS[d]);
+    __m512i end = _mm512_and_si512(mask, p_Shift8(gen, PLAYOUT_SHIFTS[d]));
+    __mmask8 closed = _mm512_test_epi64_mask(own, end);
+    flips = _mm512_mask_or_epi64(flips, closed, flips,
+                                 _mm512_xor_si512(gen, mv));
+  }
+  return flips;
+}
+
+__attribute__((target("avx512f"))) int
+PlayoutBatchAVX512(const Board *board, Turn turn, int num_playouts,
+                   PlayoutPolicy policy, PlayoutRng *rng) {
+  Turn mover = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  PlayoutLanes lanes;
+  p_InitLanes(&lanes, board, turn, num_playouts, 8);
+  __m512i own = _mm512_loadu_si512(lanes.own);
+  __m512i opp = _mm512_loadu_si512(lanes.opp);
+  __mmask8 black = _mm512_test_epi64_mask(_mm512_loadu_si512(lanes.black),
+                                          _mm512_set1_epi64(-1));
+  __mmask8 active = _mm512_test_epi64_mask(_mm512_loadu_si512(lanes.active),
+                                           _mm512_set1_epi64(-1));
+
+  int points = 0;
+  while (active != 0) {
+    __m512i moves = p_Moves8(own, opp);
+    __mmask8 stuck = active & ~_mm512_test_epi64_mask(moves, moves);
+    if (stuck != 0) {
+      __m512i t = own;
+      own = _mm512_mask_blend_epi64(stuck, own, opp);
+      opp = _mm512_mask_blend_epi64(stuck, opp, t);
+      black ^= stuck;
+      moves = _mm512_mask_blend_epi64(stuck, moves, p_Moves8(own, opp));
+      __mmask8 over = stuck & ~_mm512_test_epi64_mask(moves, moves);
+      if (over != 0) {
+        _mm512_storeu_si512(lanes.own, own);
+        _mm512_storeu_si512(lanes.opp, opp);
+        for (int i = 0; i < 8; ++i) {
+          lanes.black[i] = ((black >> i) & 1) ? ~0ULL : 0;
+          lanes.active[i] = ((active >> i) & 1) ? ~0ULL : 0;
+        }
+        points += p_FinishLanes(&lanes, over, mover);
+        own = _mm512_loadu_si512(lanes.own);
+        opp = _mm512_loadu_si512(lanes.opp);
+        black = _mm512_test_epi64_mask(_mm512_loadu_si512(lanes.black),
+                                       _mm512_set1_epi64(-1));
+        active = _mm512_test_epi64_mask(_mm512_loadu_si512(lanes.active),
+                                        _mm512_set1_epi64(-1));
+        moves = _mm512_maskz_mov_epi64(~over, moves);
+      }
+    }
+
+    uint64_t move_lanes[8];
+    uint64_t empty_lanes[8];
+    _mm512_storeu_si512(move_lanes, moves);
+    if (policy != PLAYOUT_UNIFORM) {
+      _mm512_storeu_si512(empty_lanes,
+                          _mm512_ternarylogic_epi64(own, opp, opp, 0x03));
+    }
+    p_PickMoves(move_lanes, empty_lanes, 8, policy, rng);
+    __m512i mv = _mm512_loadu_si512(move_lanes);
+    __m512i flips = p_Flips8(own, opp, mv);
+    own = _mm512_or_si512(own, _mm512_or_si512(flips, mv));
+    opp = _mm512_andnot_si512(flips, opp);
+    __mmask8 moved = _mm512_test_epi64_mask(mv, mv);
+    __m512i t = own;
+    own = _mm512_mask_blend_epi64(moved, own, opp);
+    opp = _mm512_mask_blend_epi64(moved, opp, t);
+    black ^= moved;
+  }
+  return points;
+}
+#endif // REV_AVX2_MOVEGEN
+
+// One game at a time, for CPUs without AVX2.
+int PlayoutBatchScalar(const Board *board, Turn turn, int num_playouts,
+                       PlayoutPolicy policy, PlayoutRng *rng) {
+  Turn mover = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int points = 0;
+  for (int i = 0; i < num_playouts; ++i) {
+    points += p_PlayoutPoints(Playout(board, turn, policy, rng), mover);
+  }
+  return points;
+}
+
+PlayoutBatchKernel *PLAYOUT_BATCH_KERNEL = PlayoutBatchScalar;
+int PLAYOUT_LANES = 1;
+
+__attribute__((constructor)) void p_SelectPlayoutBatchKernel() {
+#ifdef REV_AVX2_MOVEGEN
+  PLAYOUT_BATCH_KERNEL = PlayoutBatchAVX2;
+  PLAYOUT_LANES = 4;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    PLAYOUT_BATCH_KERNEL = PlayoutBatchAVX512;
+    PLAYOUT_LANES = 8;
+  }
+#endif
+}
+
+// Plays num_playouts random games from board with turn to move. Returns the
+// half-points (2 per win, 1 per tie) of the player who moved into board.
+// Batches of at least PLAYOUT_LANES games keep every lane busy.
+int PlayoutBatch(const Board *board, Turn turn, int num_playouts,
+                 PlayoutPolicy policy, PlayoutRng *rng) {
+  return PLAYOUT_BATCH_KERNEL(board, turn, num_playouts, policy, rng);
+}
+
+#endif // REV_PLAYOUT_H_
@@ -1,4 +1,4 @@
-gcc -mbmi2 -pg -o rev main.c
+gcc -mavx2 -mcx16 -fopenmp -pg -o rev main.c -lm
 ./rev
 gprof rev gmon.out > prof.txt
 rm gmon.out
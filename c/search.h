@@ -0,0 +1,466 @@
+#ifndef REV_SEARCH_H_
+#define REV_SEARCH_H_
+
+#include "board.h"
+#include "eval.h"
+#include "table.h"
+#include "timer.h"
+#include "zobrist.h"
+
+#include <omp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_INFINITY 30000
+// Finished games score SEARCH_WIN_SCORE plus the disc difference, so they
+// always outrank the evaluation.
+#define SEARCH_WIN_SCORE 20000
+#define SEARCH_MAX_DEPTH 60
+#define SEARCH_NO_MOVE 64
+// Below this depth, moves are ordered by the cheap square bonus only.
+#define SEARCH_MOBILITY_ORDERING_DEPTH 3
+// Interior nodes between clock reads.
+#define SEARCH_DEADLINE_CHECK_INTERVAL 256
+
+typedef enum { SEARCH_EXACT, SEARCH_LOWER, SEARCH_UPPER } SearchBound;
+
+typedef struct SearchEntry {
+  Board board;
+  int16_t score;
+  int8_t depth;
+  uint8_t turn;
+  uint8_t bound;
+  uint8_t best_move;
+} SearchEntry;
+
+// How an entry sits in the table: the result fields packed into data, and
+// both halves of the board XORed with data. Threads read and write slots
+// without locks, so a reader can see words from two different writes; the
+// board then fails to decode to the one being probed and the slot reads as
+// a miss (Hyatt and Mann's lockless hashing).
+typedef struct SearchSlot {
+  uint64_t blacks;
+  uint64_t whites;
+  uint64_t data;
+} SearchSlot;
+
+// Transposition table. Slots are picked by the ZobristHash() of the board,
+// which the search keeps up to date move by move, and an all-zero slot is
+// empty. Each position has one slot; a new result replaces
+// the old one unless the old one is for the same position and was searched
+// deeper. Any number of threads may share a table.
+typedef struct SearchTable {
+  SearchSlot *slots;
+  uint32_t log_capacity;
+} SearchTable;
+
+void SearchTableInit(SearchTable *table, uint32_t log_capacity) {
+  table->log_capacity = log_capacity;
+  table->slots = (SearchSlot *)calloc(1 << log_capacity, sizeof(SearchSlot));
+}
+
+void SearchTableClear(SearchTable *table) {
+  memset(table->slots, 0, (1 << table->log_capacity) * sizeof(SearchSlot));
+}
+
+void SearchTableFree(SearchTable *table) {
+  free(table->slots);
+  table->slots = NULL;
+  table->log_capacity = 0;
+}
+
+SearchSlot *p_SearchTableSlot(SearchTable *table, uint64_t hash, Turn turn) {
+  uint64_t code = hash ^ (turn * 0x9E3779B97F4A7C15);
+  return &table->slots[code >> (64 - table->log_capacity)];
+}
+
+uint64_t p_PackSearchEntry(const SearchEntry *entry) {
+  return (uint64_t)(uint16_t)entry->score |
+         (uint64_t)(uint8_t)entry->depth << 16 |
+         (uint64_t)entry->turn << 24 | (uint64_t)entry->bound << 32 |
+         (uint64_t)entry->best_move << 40;
+}
+
+// Reads the slot and decodes it into entry.
+void p_LoadSearchSlot(const SearchSlot *slot, SearchEntry *entry) {
+  uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+  entry->board.blacks = __atomic_load_n(&slot->blacks, __ATOMIC_RELAXED) ^ data;
+  entry->board.whites = __atomic_load_n(&slot->whites, __ATOMIC_RELAXED) ^ data;
+  entry->score = (int16_t)data;
+  entry->depth = (int8_t)(data >> 16);
+  entry->turn = (uint8_t)(data >> 24);
+  entry->bound = (uint8_t)(data >> 32);
+  entry->best_move = (uint8_t)(data >> 40);
+}
+
+// Copies the entry for the position into entry and returns true, or returns
+// false if there is none. hash must be ZobristHash(board).
+bool SearchTableFind(SearchTable *table, const Board *board, uint64_t hash,
+                     Turn turn, SearchEntry *entry) {
+  p_LoadSearchSlot(p_SearchTableSlot(table, hash, turn), entry);
+  return entry->board.blacks == board->blacks &&
+         entry->board.whites == board->whites && entry->turn == turn;
+}
+
+void SearchTableStore(SearchTable *table, const Board *board, uint64_t hash,
+                      Turn turn, int depth, int score, SearchBound bound,
+                      int best_move) {
+  SearchSlot *slot = p_SearchTableSlot(table, hash, turn);
+  SearchEntry entry;
+  p_LoadSearchSlot(slot, &entry);
+  bool same = entry.board.blacks == board->blacks &&
+              entry.board.whites == board->whites && entry.turn == turn;
+  if (same && entry.depth > depth) {
+    return;
+  }
+  entry.board = *board;
+  entry.score = score;
+  entry.depth = depth;
+  entry.turn = turn;
+  entry.bound = bound;
+  entry.best_move = best_move;
+  uint64_t data = p_PackSearchEntry(&entry);
+  __atomic_store_n(&slot->blacks, board->blacks ^ data, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->whites, board->whites ^ data, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->data, data, __ATOMIC_RELAXED);
+}
+
+// X-squares (diagonally next to a corner) whose corner is empty.
+uint64_t DangerousXSquares(const Board *board) {
+  uint64_t empty_corners = CORNERS & ~(board->blacks | board->whites);
+  return ((empty_corners & 0x0000000000000001) << 9) |
+         ((empty_corners & 0x0000000000000080) << 7) |
+         ((empty_corners & 0x0100000000000000) >> 7) |
+         ((empty_corners & 0x8000000000000000) >> 9);
+}
+
+// Static evaluation from the point of view of the player to move.
+int SearchEvaluate(const Board *board, Turn turn) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  uint64_t own = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  uint64_t opp = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+  uint64_t x_squares = DangerousXSquares(board);
+
+  int mobility = __builtin_popcountll(GenerateMoves(board, turn)) -
+                 __builtin_popcountll(GenerateMoves(board, next_turn));
+  int corners =
+      __builtin_popcountll(own & CORNERS) - __builtin_popcountll(opp & CORNERS);
+  int xs = __builtin_popcountll(own & x_squares) -
+           __builtin_popcountll(opp & x_squares);
+  int discs = __builtin_popcountll(own) - __builtin_popcountll(opp);
+
+  return 8 * mobility + 40 * corners - 20 * xs + discs;
+}
+
+// Score of a finished game from the point of view of the player to move.
+int SearchFinalScore(const Board *board, Turn turn) {
+  uint64_t own = (turn == BLACKS_TURN) ? board->blacks : board->whites;
+  uint64_t opp = (turn == BLACKS_TURN) ? board->whites : board->blacks;
+  int discs = __builtin_popcountll(own) - __builtin_popcountll(opp);
+  if (discs > 0) {
+    return SEARCH_WIN_SCORE + discs;
+  } else if (discs < 0) {
+    return -SEARCH_WIN_SCORE + discs;
+  }
+  return 0;
+}
+
+typedef struct Searcher {
+  SearchTable *table;
+  // Pattern weights for the evaluation, or NULL for SearchEvaluate().
+  const EvalWeights *weights;
+  uint64_t nodes;
+  // Once this passes, the search unwinds with meaningless scores, which are
+  // neither stored nor returned from SearchBestChild().
+  Deadline deadline;
+  // If not NULL, another thread can end the search by setting this, with
+  // the same effect as the deadline passing.
+  const bool *stop;
+} Searcher;
+
+// Whether the search should unwind. Checked at interior nodes.
+bool p_SearchAborted(Searcher *searcher) {
+  if (searcher->stop != NULL &&
+      __atomic_load_n(searcher->stop, __ATOMIC_RELAXED)) {
+    searcher->deadline.passed = true;
+  }
+  return DeadlinePassed(&searcher->deadline);
+}
+
+// Evaluation of a position from the point of view of the player to move.
+// state is only used with pattern weights.
+int p_SearchEvaluate(const Searcher *searcher, const Board *board,
+                     const EvalState *state, Turn turn) {
+  if (searcher->weights == NULL) {
+    return SearchEvaluate(board, turn);
+  }
+  int score = EvalScore(searcher->weights, state,
+                        __builtin_popcountll(board->blacks | board->whites));
+  // Keep evaluations well clear of finished-game scores.
+  const int max_score = 64 * EVAL_SCALE;
+  score = (score > max_score) ? max_score : score;
+  score = (score < -max_score) ? -max_score : score;
+  return (turn == BLACKS_TURN) ? score : -score;
+}
+
+// Writes the moves to squares, best first, and returns how many there are.
+// The table move goes first. Then, if depth allows, come the moves that
+// leave the opponent the fewest replies, then corners, and X-squares last.
+int p_OrderMoves(const Board *board, Turn turn, uint64_t moves, int depth,
+                 int table_move, uint8_t *squares) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  uint64_t x_squares = DangerousXSquares(board);
+  int keys[MAX_NUM_CHILD_BOARDS];
+  int count = 0;
+  while (moves != 0) {
+    int square = __builtin_ctzll(moves);
+    uint64_t mv = moves & -moves;
+    moves = moves & (moves - 1);
+
+    int key = 0;
+    if (square == table_move) {
+      key = 1 << 20;
+    } else {
+      key += (mv & CORNERS) ? 64 : 0;
+      key -= (mv & x_squares) ? 64 : 0;
+      if (depth >= SEARCH_MOBILITY_ORDERING_DEPTH) {
+        Board child = *board;
+        MakeMove(&child, turn, square);
+        key -= 16 * __builtin_popcountll(GenerateMoves(&child, next_turn));
+      }
+    }
+
+    // Insertion sort, descending by key.
+    int i = count;
+    while (i > 0 && keys[i - 1] < key) {
+      keys[i] = keys[i - 1];
+      squares[i] = squares[i - 1];
+      --i;
+    }
+    keys[i] = key;
+    squares[i] = square;
+    count++;
+  }
+  return count;
+}
+
+// Fail-soft negamax alpha-beta with principal variation search. passed means
+// the previous ply was a pass. hash must be ZobristHash(board), and with
+// pattern weights, state must describe board; both are updated
+// incrementally on the way down.
+int AlphaBeta(Searcher *searcher, const Board *board, uint64_t hash,
+              const EvalState *state, Turn turn, int depth, int alpha,
+              int beta, bool passed) {
+  searcher->nodes++;
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+
+  uint64_t moves = GenerateMoves(board, turn);
+  if (moves == 0) {
+    if (passed) {
+      return SearchFinalScore(board, turn);
+    }
+    return -AlphaBeta(searcher, board, hash, state, next_turn, depth, -beta,
+                      -alpha, true);
+  }
+  if (depth == 0) {
+    return p_SearchEvaluate(searcher, board, state, turn);
+  }
+  if (p_SearchAborted(searcher)) {
+    return 0;
+  }
+
+  int table_move = SEARCH_NO_MOVE;
+  SearchEntry entry;
+  if (SearchTableFind(searcher->table, board, hash, turn, &entry)) {
+    // Cheap insurance against a torn slot that still decodes to this
+    // position.
+    if (entry.best_move < 64 && ((moves >> entry.best_move) & 1)) {
+      table_move = entry.best_move;
+    }
+    if (entry.depth >= depth) {
+      if (entry.bound == SEARCH_EXACT) {
+        return entry.score;
+      } else if (entry.bound == SEARCH_LOWER && entry.score > alpha) {
+        alpha = entry.score;
+      } else if (entry.bound == SEARCH_UPPER && entry.score < beta) {
+        beta = entry.score;
+      }
+      if (alpha >= beta) {
+        return entry.score;
+      }
+    }
+  }
+
+  uint8_t squares[MAX_NUM_CHILD_BOARDS];
+  int count = p_OrderMoves(board, turn, moves, depth, table_move, squares);
+
+  int alpha_orig = alpha;
+  int best = -SEARCH_INFINITY;
+  int best_move = squares[0];
+  for (int i = 0; i < count; ++i) {
+    Board child = *board;
+    uint64_t flips = ComputeFlips(board, turn, squares[i]);
+    ApplyMove(&child, turn, squares[i], flips);
+    uint64_t child_hash = hash ^ ZobristMoveDelta(turn, squares[i], flips);
+    EvalState child_state;
+    if (searcher->weights != NULL) {
+      child_state = *state;
+      EvalStateUpdate(&child_state, turn, squares[i], flips);
+    }
+    // Principal variation search: after the first move, only try to show a
+    // move is no better than alpha, and re-search the ones that are.
+    int score;
+    if (i == 0) {
+      score = -AlphaBeta(searcher, &child, child_hash, &child_state,
+                         next_turn, depth - 1, -beta, -alpha, false);
+    } else {
+      score = -AlphaBeta(searcher, &child, child_hash, &child_state,
+                         next_turn, depth - 1, -alpha - 1, -alpha, false);
+      if (score > alpha && score < beta) {
+        score = -AlphaBeta(searcher, &child, child_hash, &child_state,
+                           next_turn, depth - 1, -beta, -score, false);
+      }
+    }
+    if (searcher->deadline.passed) {
+      return 0;
+    }
+    if (score > best) {
+      best = score;
+      best_move = squares[i];
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) {
+          break;
+        }
+      }
+    }
+  }
+
+  SearchBound bound = SEARCH_EXACT;
+  if (best <= alpha_orig) {
+    bound = SEARCH_UPPER;
+  } else if (best >= beta) {
+    bound = SEARCH_LOWER;
+  }
+  SearchTableStore(searcher->table, board, hash, turn, depth, best, bound,
+                   best_move);
+  return best;
+}
+
+// SearchBestChild(), deepening from first_depth.
+int p_SearchIterate(Searcher *searcher, Turn turn, const ChildBoards *choices,
+                    int first_depth, int max_depth, int *score) {
+  Turn next_turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+  int order[MAX_NUM_CHILD_BOARDS];
+  int scores[MAX_NUM_CHILD_BOARDS];
+  EvalState states[MAX_NUM_CHILD_BOARDS];
+  uint64_t hashes[MAX_NUM_CHILD_BOARDS];
+  for (int i = 0; i < choices->count; ++i) {
+    order[i] = i;
+    hashes[i] = ZobristHash(&choices->boards[i]);
+    if (searcher->weights != NULL) {
+      EvalStateInit(&states[i], &choices->boards[i]);
+    }
+  }
+
+  const Board *first = &choices->boards[0];
+  int num_empties = __builtin_popcountll(~(first->blacks | first->whites));
+  int best = 0;
+  int best_score = 0;
+  for (int depth = first_depth;
+       depth <= max_depth && depth - 1 <= num_empties; ++depth) {
+    int alpha = -SEARCH_INFINITY;
+    for (int i = 0; i < choices->count && !searcher->deadline.passed; ++i) {
+      int c = order[i];
+      const Board *child = &choices->boards[c];
+      if (i == 0) {
+        scores[c] = -AlphaBeta(searcher, child, hashes[c], &states[c],
+                               next_turn, depth - 1, -SEARCH_INFINITY,
+                               SEARCH_INFINITY, false);
+      } else {
+        scores[c] = -AlphaBeta(searcher, child, hashes[c], &states[c],
+                               next_turn, depth - 1, -alpha - 1, -alpha,
+                               false);
+        if (scores[c] > alpha) {
+          scores[c] = -AlphaBeta(searcher, child, hashes[c], &states[c],
+                                 next_turn, depth - 1, -SEARCH_INFINITY,
+                                 -scores[c], false);
+        }
+      }
+      if (scores[c] > alpha) {
+        alpha = scores[c];
+      }
+    }
+    if (searcher->deadline.passed) {
+      break;
+    }
+
+    // Stable insertion sort of the root moves, best first. Moves that failed
+    // low keep their relative order.
+    for (int i = 1; i < choices->count; ++i) {
+      int c = order[i];
+      int j = i;
+      while (j > 0 && scores[order[j - 1]] < scores[c]) {
+        order[j] = order[j - 1];
+        --j;
+      }
+      order[j] = c;
+    }
+    best = order[0];
+    best_score = scores[best];
+  }
+
+  *score = best_score;
+  return best;
+}
+
+// Iteratively deepens from depth 1 to max_depth over choices, the children
+// of a position where turn is to move. Each iteration searches the root
+// moves in order of the previous iteration's scores. Deepening also stops
+// once it reaches the end of the game, or when the searcher's deadline
+// passes, in which case the unfinished iteration is dropped. Depth 1 always
+// finishes. Returns the index of the best choice and stores its score in
+// score.
+int SearchBestChild(Searcher *searcher, Turn turn, const ChildBoards *choices,
+                    int max_depth, int *score) {
+  return p_SearchIterate(searcher, turn, choices, 1, max_depth, score);
+}
+
+// SearchBestChild() on num_threads threads sharing searcher's table (Lazy
+// SMP). Thread 0 runs SearchBestChild() and its answer is returned. The
+// other threads run the same search, every other one starting a ply deeper
+// so they drift apart, only to fill the table with results that thread 0
+// then picks up; they stop when it is done. Adds the nodes of all threads to
+// searcher->nodes.
+int SearchBestChildParallel(Searcher *searcher, Turn turn,
+                            const ChildBoards *choices, int max_depth,
+                            int num_threads, int *score) {
+  if (num_threads <= 1) {
+    return SearchBestChild(searcher, turn, choices, max_depth, score);
+  }
+  bool stop = false;
+  int best = 0;
+  uint64_t nodes = 0;
+#pragma omp parallel num_threads(num_threads) reduction(+ : nodes)
+  {
+    Searcher own = *searcher;
+    own.nodes = 0;
+    int id = omp_get_thread_num();
+    if (id == 0) {
+      best = SearchBestChild(&own, turn, choices, max_depth, score);
+      __atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+    } else {
+      int helper_score;
+      own.stop = &stop;
+      p_SearchIterate(&own, turn, choices, 1 + id % 2, max_depth,
+                      &helper_score);
+    }
+    nodes += own.nodes;
+  }
+  searcher->nodes += nodes;
+  return best;
+}
+
+#endif // REV_SEARCH_H_
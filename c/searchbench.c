@@ -0,0 +1,89 @@
+// Parallel search benchmark. Searches a fixed set of random midgame
+// positions to a fixed depth with SearchBestChildParallel() at 1 to
+// max_threads threads, each position starting from an empty table, and
+// reports the time to depth, nodes/sec and speedup over one thread. Also
+// counts the positions where the chosen move differs from the one-thread
+// search (Lazy SMP may legitimately pick another move of equal score).
+//
+// Usage: ./searchbench [depth] [max_threads] [num_positions]
+
+#include "board.h"
+#include "explore.h"
+#include "mtwister.h"
+#include "search.h"
+#include "timer.h"
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Random plies from the opening board to each position (black to move).
+#define SEARCHBENCH_PLIES 20
+#define SEARCHBENCH_TABLE_LOG_CAPACITY 20
+
+int main(int argc, char *argv[]) {
+  int depth = (argc > 1) ? atoi(argv[1]) : 9;
+  int max_threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+  int num_positions = (argc > 3) ? atoi(argv[3]) : 20;
+
+  Board *positions = (Board *)malloc(num_positions * sizeof(Board));
+  MTRand rng = seedRand(1);
+  Board start = OpeningBoard();
+  int found = 0;
+  while (found < num_positions) {
+    Board board = RandomSampleBoardDepthFirst(&start, BLACKS_TURN,
+                                              SEARCHBENCH_PLIES, &rng);
+    // A sample cut short by a pass has the wrong side to move.
+    if (__builtin_popcountll(board.blacks | board.whites) ==
+            4 + SEARCHBENCH_PLIES &&
+        GenerateMoves(&board, BLACKS_TURN) != 0) {
+      positions[found++] = board;
+    }
+  }
+
+  int *serial_moves = (int *)malloc(num_positions * sizeof(int));
+  double serial_seconds = 0.0;
+  SearchTable table;
+  SearchTableInit(&table, SEARCHBENCH_TABLE_LOG_CAPACITY);
+  printf("depth %d, %d positions\n", depth, num_positions);
+  for (int threads = 1; threads <= max_threads; ++threads) {
+    uint64_t nodes = 0;
+    int changed = 0;
+    double start_time = ClockNow();
+    for (int p = 0; p < num_positions; ++p) {
+      ChildBoards choices;
+      GenerateChildBoards(&positions[p], BLACKS_TURN, &choices);
+      SearchTableClear(&table);
+      Searcher searcher = {
+          .table = &table,
+          .nodes = 0,
+          .deadline =
+              DeadlineMake(NO_DEADLINE, SEARCH_DEADLINE_CHECK_INTERVAL)};
+      int score;
+      int move = SearchBestChildParallel(&searcher, BLACKS_TURN, &choices,
+                                         depth, threads, &score);
+      nodes += searcher.nodes;
+      if (threads == 1) {
+        serial_moves[p] = move;
+      } else if (move != serial_moves[p]) {
+        changed++;
+      }
+    }
+    double seconds = ClockNow() - start_time;
+    if (threads == 1) {
+      serial_seconds = seconds;
+    }
+    printf("%2d threads: %8.3fs  %12" PRIu64 " nodes  %10.0f nodes/sec  "
+           "speedup %.2fx  %d moves changed\n",
+           threads, seconds, nodes, nodes / seconds, serial_seconds / seconds,
+           changed);
+  }
+
+  SearchTableFree(&table);
+  free(serial_moves);
+  free(positions);
+  return 0;
+}
@@ -2,10 +2,16 @@
 #define REV_TABLE_H_
 
 #include "board.h"
+#include "list.h"
 
+#include <emmintrin.h>
 #include <math.h>
+#include <omp.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 typedef uint32_t H32(const Board *board);
 
@@ -16,25 +22,25 @@ uint32_t hash4(const Board *board) { return board->blacks * board->whites; }
 uint32_t hash5(const Board *board) { return board->blacks ^ board->whites; }
 uint32_t hash6(const Board *board) {
   uint64_t x = board->blacks + board->whites;
-  return (x & 0xFFFFFFFF ^ (x >> 32) & 0xFFFFFFFF);
+  return (x & 0xFFFFFFFF) ^ ((x >> 32) & 0xFFFFFFFF);
 }
 uint32_t hash7(const Board *board) {
   uint64_t x = board->blacks * board->whites;
-  return (x & 0xFFFFFFFF ^ (x >> 32) & 0xFFFFFFFF);
+  return (x & 0xFFFFFFFF) ^ ((x >> 32) & 0xFFFFFFFF);
 }
 uint32_t hash8(const Board *board) {
   uint64_t x = board->blacks - board->whites;
-  return (x & 0xFFFFFFFF ^ (x >> 32) & 0xFFFFFFFF);
+  return (x & 0xFFFFFFFF) ^ ((x >> 32) & 0xFFFFFFFF);
 }
 uint32_t hash9(const Board *board) {
   uint64_t x = board->blacks - board->whites;
   x = x * 0x118F20237E9B23C7;
-  return (x & 0xFFFFFFFF ^ (x >> 32) & 0xFFFFFFFF);
+  return (x & 0xFFFFFFFF) ^ ((x >> 32) & 0xFFFFFFFF);
 }
 uint32_t hash10(const Board *board) {
   uint64_t x = board->blacks - board->whites;
   x = x * 0x114F20237E9B23C7;
-  return (x & 0xFFFFFFFF ^ (x >> 32) & 0xFFFFFFFF);
+  return (x & 0xFFFFFFFF) ^ ((x >> 32) & 0xFFFFFFFF);
 }
 
 void EvaluateHash32Function(BoardList *list, H32 *hash) {
@@ -45,7 +51,7 @@ void EvaluateHash32Function(BoardList *list, H32 *hash) {
 
   Board *next;
   ResetBoardIter(list);
-  while (next = NextBoard(list)) {
+  while ((next = NextBoard(list))) {
     uint32_t code = hash(next);
     for (int i = 0; i < 32; ++i) {
       counts[i] += (code >> i) & 1;
@@ -157,4 +163,515 @@ bool BoardSetHas(BoardSet *set, const Board *board) {
   return found;
 }
 
+// Adds board unless the set already has it. Returns whether it was added.
+bool BoardSetAddIfAbsent(BoardSet *set, const Board *board) {
+  if (BoardSetHas(set, board)) {
+    return false;
+  }
+  BoardSetAdd(set, board);
+  return true;
+}
+
+// Shards of a ShardedBoardSet, picked by the top bits of hash10. A shard
+// would need 2^(32 - BOARD_SET_SHARD_BITS) slots before its own index bits
+// ran into them.
+#define BOARD_SET_SHARD_BITS 8
+#define BOARD_SET_NUM_SHARDS (1 << BOARD_SET_SHARD_BITS)
+
+// A BoardSet that many threads can add to at once. Each shard is a BoardSet
+// with its own lock, so threads only wait for each other when they hit the
+// same shard, and a shard grows without stopping the others.
+typedef struct ShardedBoardSet {
+  BoardSet shards[BOARD_SET_NUM_SHARDS];
+  omp_lock_t locks[BOARD_SET_NUM_SHARDS];
+} ShardedBoardSet;
+
+void ShardedBoardSetInit(ShardedBoardSet *set) {
+  for (int i = 0; i < BOARD_SET_NUM_SHARDS; ++i) {
+    BoardSetInit(&set->shards[i]);
+    omp_init_lock(&set->locks[i]);
+  }
+}
+
+void ShardedBoardSetFree(ShardedBoardSet *set) {
+  for (int i = 0; i < BOARD_SET_NUM_SHARDS; ++i) {
+    BoardSetFree(&set->shards[i]);
+    omp_destroy_lock(&set->locks[i]);
+  }
+}
+
+uint32_t p_BoardSetShard(const Board *board) {
+  return hash10(board) >> (32 - BOARD_SET_SHARD_BITS);
+}
+
+// Thread-safe BoardSetAddIfAbsent().
+bool ShardedBoardSetAddIfAbsent(ShardedBoardSet *set, const Board *board) {
+  uint32_t shard = p_BoardSetShard(board);
+  omp_set_lock(&set->locks[shard]);
+  bool added = BoardSetAddIfAbsent(&set->shards[shard], board);
+  omp_unset_lock(&set->locks[shard]);
+  return added;
+}
+
+// Thread-safe BoardSetHas().
+bool ShardedBoardSetHas(ShardedBoardSet *set, const Board *board) {
+  uint32_t shard = p_BoardSetShard(board);
+  omp_set_lock(&set->locks[shard]);
+  bool found = BoardSetHas(&set->shards[shard], board);
+  omp_unset_lock(&set->locks[shard]);
+  return found;
+}
+
+// Not safe while other threads are adding.
+uint64_t ShardedBoardSetSize(const ShardedBoardSet *set) {
+  uint64_t size = 0;
+  for (int i = 0; i < BOARD_SET_NUM_SHARDS; ++i) {
+    size += set->shards[i].size;
+  }
+  return size;
+}
+
+// A lock-free set of boards. Each slot holds a whole Board, and adding one
+// is a single 16-byte compare-and-swap of an empty slot (cmpxchg16b, so
+// build with -mcx16). Slots are probed linearly from hash10, as in
+// BoardSet, so the capacity is at most 2^32.
+//
+// Once a table is 70% full the set grows into one twice the size. Threads
+// that try to add while this is under way help: they claim chunks of the
+// old table, mark each empty slot there as moved (again by CAS, so nothing
+// can land in it afterwards) and copy each board over, then insert into the
+// new table once every chunk is done. A set sized for its workload up front
+// never grows. Old tables are only freed with the set, since a slow thread
+// may still be reading them.
+
+typedef unsigned __int128 BoardSlot;
+
+// Markers for a free slot and for one whose table has moved. No reachable
+// position has fewer than two discs.
+#define BOARD_SLOT_EMPTY ((BoardSlot)0)
+#define BOARD_SLOT_MOVED ((BoardSlot)1 << 64)
+// Slots each helper copies at a time while the set grows.
+#define BOARD_TABLE_CHUNK 1024
+
+typedef struct BoardTable BoardTable;
+
+typedef struct BoardTable {
+  BoardSlot *slots;
+  uint32_t log_capacity;
+  // Boards stored here, including ones copied in.
+  uint64_t count;
+  // Slots claimed and slots copied by the threads moving this table into
+  // next.
+  uint64_t claimed;
+  uint64_t done;
+  // The table replacing this one, or NULL.
+  BoardTable *next;
+} BoardTable;
+
+typedef struct ConcurrentBoardSet {
+  // The oldest table, which leads to all the others through next.
+  BoardTable *first;
+  BoardTable *current;
+  uint64_t size;
+} ConcurrentBoardSet;
+
+BoardTable *p_MakeBoardTable(uint32_t log_capacity) {
+  BoardTable *table = (BoardTable *)malloc(sizeof(BoardTable));
+  size_t bytes = ((size_t)1 << log_capacity) * sizeof(BoardSlot);
+  table->slots = (BoardSlot *)aligned_alloc(sizeof(BoardSlot), bytes);
+  memset(table->slots, 0, bytes);
+  table->log_capacity = log_capacity;
+  table->count = 0;
+  table->claimed = 0;
+  table->done = 0;
+  table->next = NULL;
+  return table;
+}
+
+void ConcurrentBoardSetInit(ConcurrentBoardSet *set, uint32_t log_capacity) {
+  set->first = p_MakeBoardTable(log_capacity);
+  set->current = set->first;
+  set->size = 0;
+}
+
+void ConcurrentBoardSetFree(ConcurrentBoardSet *set) {
+  BoardTable *table = set->first;
+  while (table != NULL) {
+    BoardTable *next = table->next;
+    free(table->slots);
+    free(table);
+    table = next;
+  }
+  set->first = NULL;
+  set->current = NULL;
+  set->size = 0;
+}
+
+BoardSlot p_BoardSlotOf(const Board *board) {
+  return ((BoardSlot)board->whites << 64) | board->blacks;
+}
+
+// Reads a slot. The two halves are read separately, which is only torn if
+// they straddle the one write an empty slot ever gets, and then one of them
+// reads as zero; a real CAS settles that case. Both reading zero can only
+// mean the slot was empty a moment ago, which is all a probe needs: adding
+// goes through a CAS that fails if it has been filled since.
+BoardSlot p_LoadBoardSlot(BoardSlot *slot) {
+  uint64_t *halves = (uint64_t *)slot;
+  uint64_t low = __atomic_load_n(&halves[0], __ATOMIC_ACQUIRE);
+  uint64_t high = __atomic_load_n(&halves[1], __ATOMIC_ACQUIRE);
+  if (low == 0 && high == 0) {
+    return BOARD_SLOT_EMPTY;
+  } else if (low == 0 || high == 0) {
+    return __sync_val_compare_and_swap(slot, BOARD_SLOT_EMPTY,
+                                       BOARD_SLOT_EMPTY);
+  }
+  return ((BoardSlot)high << 64) | low;
+}
+
+// Makes the table that will replace table, unless another thread has.
+void p_GrowBoardTable(BoardTable *table) {
+  if (__atomic_load_n(&table->next, __ATOMIC_ACQUIRE) != NULL) {
+    return;
+  }
+  BoardTable *next = p_MakeBoardTable(table->log_capacity + 1);
+  BoardTable *expected = NULL;
+  if (!__atomic_compare_exchange_n(&table->next, &expected, next, false,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    free(next->slots);
+    free(next);
+  }
+}
+
+bool p_ConcurrentBoardSetInsert(ConcurrentBoardSet *set, BoardTable *table,
+                                BoardSlot key, uint32_t code);
+
+// Helps move table into table->next and returns once it is all there.
+void p_MoveBoardTable(ConcurrentBoardSet *set, BoardTable *table) {
+  BoardTable *next = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+  uint64_t capacity = (uint64_t)1 << table->log_capacity;
+  while (true) {
+    uint64_t first = __atomic_fetch_add(&table->claimed, BOARD_TABLE_CHUNK,
+                                        __ATOMIC_RELAXED);
+    if (first >= capacity) {
+      break;
+    }
+    uint64_t last = first + BOARD_TABLE_CHUNK;
+    last = (last < capacity) ? last : capacity;
+    for (uint64_t i = first; i < last; ++i) {
+      BoardSlot slot = __sync_val_compare_and_swap(
+          &table->slots[i], BOARD_SLOT_EMPTY, BOARD_SLOT_MOVED);
+      if (slot != BOARD_SLOT_EMPTY) {
+        Board board = {.blacks = (uint64_t)slot,
+                       .whites = (uint64_t)(slot >> 64)};
+        p_ConcurrentBoardSetInsert(set, next, slot, hash10(&board));
+      }
+    }
+    __atomic_fetch_add(&table->done, last - first, __ATOMIC_RELEASE);
+  }
+  while (__atomic_load_n(&table->done, __ATOMIC_ACQUIRE) < capacity) {
+    sched_yield();
+  }
+  BoardTable *expected = table;
+  __atomic_compare_exchange_n(&set->current, &expected, next, false,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Adds key to table, or to whatever replaced it. Returns whether it was
+// added.
+bool p_ConcurrentBoardSetInsert(ConcurrentBoardSet *set, BoardTable *table,
+                                BoardSlot key, uint32_t code) {
+  while (true) {
+    if (__atomic_load_n(&table->next, __ATOMIC_ACQUIRE) != NULL) {
+      p_MoveBoardTable(set, table);
+      table = table->next;
+      continue;
+    }
+    uint64_t mask = ((uint64_t)1 << table->log_capacity) - 1;
+    uint64_t index = code & mask;
+    for (uint64_t probe = 0; probe <= mask; ++probe) {
+      BoardSlot slot = p_LoadBoardSlot(&table->slots[index]);
+      if (slot == BOARD_SLOT_EMPTY) {
+        slot = __sync_val_compare_and_swap(&table->slots[index],
+                                           BOARD_SLOT_EMPTY, key);
+        if (slot == BOARD_SLOT_EMPTY) {
+          uint64_t count =
+              __atomic_add_fetch(&table->count, 1, __ATOMIC_RELAXED);
+          if (count * 10 > (mask + 1) * 7) {
+            p_GrowBoardTable(table);
+          }
+          return true;
+        }
+      }
+      if (slot == key) {
+        return false;
+      } else if (slot == BOARD_SLOT_MOVED) {
+        break;
+      }
+      index = (index + 1) & mask;
+    }
+    // Moved away from under us, or full.
+    p_GrowBoardTable(table);
+  }
+}
+
+// Adds board unless the set already has it. Returns whether it was added.
+// Safe to call from any number of threads at once.
+bool ConcurrentBoardSetAdd(ConcurrentBoardSet *set, const Board *board) {
+  BoardTable *table = __atomic_load_n(&set->current, __ATOMIC_ACQUIRE);
+  if (!p_ConcurrentBoardSetInsert(set, table, p_BoardSlotOf(board),
+                                  hash10(board))) {
+    return false;
+  }
+  __atomic_fetch_add(&set->size, 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool ConcurrentBoardSetHas(ConcurrentBoardSet *set, const Board *board) {
+  BoardSlot key = p_BoardSlotOf(board);
+  uint32_t code = hash10(board);
+  BoardTable *table = __atomic_load_n(&set->current, __ATOMIC_ACQUIRE);
+  while (table != NULL) {
+    uint64_t mask = ((uint64_t)1 << table->log_capacity) - 1;
+    uint64_t index = code & mask;
+    for (uint64_t probe = 0; probe <= mask; ++probe) {
+      BoardSlot slot = p_LoadBoardSlot(&table->slots[index]);
+      if (slot == key) {
+        return true;
+      } else if (slot == BOARD_SLOT_EMPTY) {
+        return false;
+      } else if (slot == BOARD_SLOT_MOVED) {
+        break;
+      }
+      index = (index + 1) & mask;
+    }
+    table = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+  }
+  return false;
+}
+
+uint64_t ConcurrentBoardSetSize(ConcurrentBoardSet *set) {
+  return __atomic_load_n(&set->size, __ATOMIC_RELAXED);
+}
+
+// 64-bit hash of a board whose top and bottom bits are both usable (the
+// murmur3 finalizer over the two bitboards).
+uint64_t BoardHash64(const Board *board) {
+  uint64_t x = board->blacks ^ (board->whites * 0xC2B2AE3D27D4EB4F);
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCD;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53;
+  x ^= x >> 33;
+  return x;
+}
+
+typedef uint64_t H64(const Board *board);
+
+// A set of boards laid out like a Swiss table. Slots come in groups of 16
+// with one control byte each, holding FLAT_SET_EMPTY or the low 7 bits of
+// the hash of the board in the slot. The rest of the hash picks
+// the first group to probe. A probe compares the 16 control bytes of a
+// group with the fragment in one SSE2 instruction and only looks at boards
+// whose fragment matches, about one in 128 of the others; a group with an
+// empty slot ends it. Grows at 7/8 load, and has no deletion.
+#define FLAT_SET_GROUP_SIZE 16
+#define FLAT_SET_EMPTY 0x80
+// Boards the batch calls hash and prefetch before probing any of them.
+#define FLAT_SET_LOOKAHEAD 16
+
+typedef struct FlatBoardSet {
+  // Any hash with well-mixed bits, e.g. BoardHash64 or ZobristHash. Only
+  // called by the calls that are not given hashes, and to grow.
+  H64 *hash;
+  uint8_t *controls;
+  Board *boards;
+  uint64_t size;
+  uint32_t log_capacity;
+} FlatBoardSet;
+
+void p_FlatBoardSetAllocate(FlatBoardSet *set, uint32_t log_capacity) {
+  if (log_capacity < 4) {
+    log_capacity = 4;
+  }
+  size_t capacity = (size_t)1 << log_capacity;
+  set->controls = (uint8_t *)aligned_alloc(FLAT_SET_GROUP_SIZE, capacity);
+  memset(set->controls, FLAT_SET_EMPTY, capacity);
+  set->boards = (Board *)aligned_alloc(64, capacity * sizeof(Board));
+  set->size = 0;
+  set->log_capacity = log_capacity;
+}
+
+// Starts with room for 7/8 of 2^log_capacity boards.
+void FlatBoardSetInit(FlatBoardSet *set, uint32_t log_capacity, H64 *hash) {
+  set->hash = hash;
+  p_FlatBoardSetAllocate(set, log_capacity);
+}
+
+void FlatBoardSetFree(FlatBoardSet *set) {
+  free(set->controls);
+  free(set->boards);
+  set->controls = NULL;
+  set->boards = NULL;
+  set->size = 0;
+  set->log_capacity = 0;
+}
+
+uint64_t p_FlatBoardSetFirstGroup(const FlatBoardSet *set, uint64_t hash) {
+  return (hash >> 7) & (((uint64_t)1 << (set->log_capacity - 4)) - 1);
+}
+
+// Returns the slot holding board, or -1 if there is none, in which case
+// empty is set to the slot where it would go.
+int64_t p_FlatBoardSetFind(const FlatBoardSet *set, const Board *board,
+                           uint64_t hash, uint64_t *empty) {
+  uint64_t group_mask = ((uint64_t)1 << (set->log_capacity - 4)) - 1;
+  uint64_t group = p_FlatBoardSetFirstGroup(set, hash);
+  __m128i fragment = _mm_set1_epi8(hash & 0x7F);
+  while (true) {
+    uint64_t first = group * FLAT_SET_GROUP_SIZE;
+    __m128i controls =
+        _mm_load_si128((const __m128i *)&set->controls[first]);
+    uint32_t matches =
+        _mm_movemask_epi8(_mm_cmpeq_epi8(controls, fragment));
+    while (matches != 0) {
+      uint64_t slot = first + __builtin_ctz(matches);
+      matches = matches & (matches - 1);
+      if (set->boards[slot].blacks == board->blacks &&
+          set->boards[slot].whites == board->whites) {
+        return slot;
+      }
+    }
+    uint32_t empties = _mm_movemask_epi8(controls);
+    if (empties != 0) {
+      *empty = first + __builtin_ctz(empties);
+      return -1;
+    }
+    group = (group + 1) & group_mask;
+  }
+}
+
+void p_FlatBoardSetGrow(FlatBoardSet *set) {
+  FlatBoardSet old = *set;
+  p_FlatBoardSetAllocate(set, old.log_capacity + 1);
+  size_t capacity = (size_t)1 << old.log_capacity;
+  for (size_t i = 0; i < capacity; ++i) {
+    if (old.controls[i] == FLAT_SET_EMPTY) {
+      continue;
+    }
+    uint64_t hash = set->hash(&old.boards[i]);
+    uint64_t empty;
+    p_FlatBoardSetFind(set, &old.boards[i], hash, &empty);
+    set->controls[empty] = hash & 0x7F;
+    set->boards[empty] = old.boards[i];
+  }
+  set->size = old.size;
+  FlatBoardSetFree(&old);
+}
+
+// The calls taking a hash expect set->hash(board), so that callers that
+// need it several times, or can compute it more cheaply, pass it in.
+bool FlatBoardSetHasHashed(const FlatBoardSet *set, const Board *board,
+                           uint64_t hash) {
+  uint64_t empty;
+  return p_FlatBoardSetFind(set, board, hash, &empty) >= 0;
+}
+
+// Adds board unless the set already has it. Returns whether it was added.
+bool FlatBoardSetAddHashed(FlatBoardSet *set, const Board *board,
+                           uint64_t hash) {
+  uint64_t capacity = (uint64_t)1 << set->log_capacity;
+  if (8 * (set->size + 1) > 7 * capacity) {
+    p_FlatBoardSetGrow(set);
+  }
+  uint64_t empty;
+  if (p_FlatBoardSetFind(set, board, hash, &empty) >= 0) {
+    return false;
+  }
+  set->controls[empty] = hash & 0x7F;
+  set->boards[empty] = *board;
+  set->size++;
+  return true;
+}
+
+bool FlatBoardSetHas(const FlatBoardSet *set, const Board *board) {
+  return FlatBoardSetHasHashed(set, board, set->hash(board));
+}
+
+bool FlatBoardSetAdd(FlatBoardSet *set, const Board *board) {
+  return FlatBoardSetAddHashed(set, board, set->hash(board));
+}
+
+// Prefetches the groups that boards with these hashes start probing at.
+void p_FlatBoardSetPrefetch(const FlatBoardSet *set, const uint64_t *hashes,
+                            int count) {
+  for (int i = 0; i < count; ++i) {
+    uint64_t first =
+        p_FlatBoardSetFirstGroup(set, hashes[i]) * FLAT_SET_GROUP_SIZE;
+    __builtin_prefetch(&set->controls[first]);
+    __builtin_prefetch(&set->boards[first]);
+  }
+}
+
+// FlatBoardSetHasHashed() for count boards, storing the answers in found.
+// Each run of FLAT_SET_LOOKAHEAD boards is prefetched before any of it is
+// probed, so their cache misses overlap.
+void FlatBoardSetHasBatchHashed(const FlatBoardSet *set, const Board *boards,
+                                const uint64_t *hashes, int count,
+                                bool *found) {
+  for (int i = 0; i < count; i += FLAT_SET_LOOKAHEAD) {
+    int n = (count - i < FLAT_SET_LOOKAHEAD) ? count - i : FLAT_SET_LOOKAHEAD;
+    p_FlatBoardSetPrefetch(set, hashes + i, n);
+    for (int j = i; j < i + n; ++j) {
+      found[j] = FlatBoardSetHasHashed(set, &boards[j], hashes[j]);
+    }
+  }
+}
+
+// FlatBoardSetAddHashed() for count boards, in order, storing in added
+// whether each was added, and returning how many were. Prefetches like
+// FlatBoardSetHasBatchHashed().
+int FlatBoardSetAddBatchHashed(FlatBoardSet *set, const Board *boards,
+                               const uint64_t *hashes, int count,
+                               bool *added) {
+  int num_added = 0;
+  for (int i = 0; i < count; i += FLAT_SET_LOOKAHEAD) {
+    int n = (count - i < FLAT_SET_LOOKAHEAD) ? count - i : FLAT_SET_LOOKAHEAD;
+    p_FlatBoardSetPrefetch(set, hashes + i, n);
+    for (int j = i; j < i + n; ++j) {
+      added[j] = FlatBoardSetAddHashed(set, &boards[j], hashes[j]);
+      num_added += added[j];
+    }
+  }
+  return num_added;
+}
+
+// The batch calls above, hashing FLAT_SET_LOOKAHEAD boards at a time first.
+void FlatBoardSetHasBatch(const FlatBoardSet *set, const Board *boards,
+                          int count, bool *found) {
+  uint64_t hashes[FLAT_SET_LOOKAHEAD];
+  for (int i = 0; i < count; i += FLAT_SET_LOOKAHEAD) {
+    int n = (count - i < FLAT_SET_LOOKAHEAD) ? count - i : FLAT_SET_LOOKAHEAD;
+    for (int j = 0; j < n; ++j) {
+      hashes[j] = set->hash(&boards[i + j]);
+    }
+    FlatBoardSetHasBatchHashed(set, boards + i, hashes, n, found + i);
+  }
+}
+
+int FlatBoardSetAddBatch(FlatBoardSet *set, const Board *boards, int count,
+                         bool *added) {
+  uint64_t hashes[FLAT_SET_LOOKAHEAD];
+  int num_added = 0;
+  for (int i = 0; i < count; i += FLAT_SET_LOOKAHEAD) {
+    int n = (count - i < FLAT_SET_LOOKAHEAD) ? count - i : FLAT_SET_LOOKAHEAD;
+    for (int j = 0; j < n; ++j) {
+      hashes[j] = set->hash(&boards[i + j]);
+    }
+    num_added +=
+        FlatBoardSetAddBatchHashed(set, boards + i, hashes, n, added + i);
+  }
+  return num_added;
+}
+
 #endif // REV_TABLE_H_
@@ -0,0 +1,80 @@
+#ifndef REV_TIMER_H_
+#define REV_TIMER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// Deadlines are ClockNow() values. NO_DEADLINE means search for a fixed
+// amount of work instead.
+#define NO_DEADLINE 0.0
+// Time left on a game clock is shared out as if this many more of our moves
+// were still to come than the empties suggest, to keep a reserve.
+#define TIME_RESERVE_MOVES 2
+
+// Seconds on a monotonic clock.
+double ClockNow() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Reading the clock costs about as much as a few moves, so a search asks a
+// Deadline whether it has passed as often as it likes and the clock is only
+// read every interval calls. Each thread needs its own Deadline.
+typedef struct Deadline {
+  double at;
+  uint32_t interval;
+  uint32_t calls;
+  bool passed;
+} Deadline;
+
+Deadline DeadlineMake(double at, uint32_t interval) {
+  Deadline deadline = {
+      .at = at, .interval = interval, .calls = 0, .passed = false};
+  return deadline;
+}
+
+bool DeadlinePassed(Deadline *deadline) {
+  if (deadline->passed) {
+    return true;
+  }
+  if (deadline->at == NO_DEADLINE || ++deadline->calls < deadline->interval) {
+    return false;
+  }
+  deadline->calls = 0;
+  deadline->passed = ClockNow() >= deadline->at;
+  return deadline->passed;
+}
+
+// How long an AI may think. Zero fields are unlimited; with both zero the
+// AI does its fixed amount of work.
+typedef struct TimeBudget {
+  // Limit for each move.
+  double move_seconds;
+  // Total for all of one side's moves in a game.
+  double game_seconds;
+} TimeBudget;
+
+bool TimeBudgetIsSet(const TimeBudget *budget) {
+  return budget->move_seconds > 0.0 || budget->game_seconds > 0.0;
+}
+
+// Seconds to spend on a move with num_empties empty squares, given the time
+// left on the game clock.
+double TimeBudgetForMove(const TimeBudget *budget, double remaining_seconds,
+                         int num_empties) {
+  double seconds = budget->move_seconds;
+  if (budget->game_seconds > 0.0) {
+    // We make about half of the remaining moves.
+    int moves_left = (num_empties + 1) / 2 + TIME_RESERVE_MOVES;
+    double share = remaining_seconds / moves_left;
+    share = (share > 0.0) ? share : 0.0;
+    if (seconds <= 0.0 || share < seconds) {
+      seconds = share;
+    }
+  }
+  return seconds;
+}
+
+#endif // REV_TIMER_H_
@@ -0,0 +1,260 @@
+// Fits pattern evaluation weights (see eval.h) to game records.
+//
+// Usage: ./train play <games_file> <num_games> [depth]
+//        ./train fit <games_file> <weights_file> [epochs] [rate]
+//
+// play appends self-play games to games_file: depth-limited alpha-beta with
+// an exact endgame solver, starting from a few random moves so that games
+// differ. fit streams the records and fits the weights by least squares,
+// with every position in a game's history labeled by its final disc
+// difference. Each epoch is one pass over the file: gradients are summed per
+// thread, then every weight takes a step scaled by how often it was seen
+// (plus a regularization constant, which keeps rare weights near zero).
+// rate scales that step; 1 is stable. Every TRAIN_VALIDATION_EVERY-th game
+// is held out for validation. ./rev <weights_file> plays with the result.
+
+#include "ai.h"
+#include "board.h"
+#include "eval.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRAIN_CHUNK_GAMES 4096
+#define TRAIN_VALIDATION_EVERY 10
+#define TRAIN_RANDOM_OPENING_MOVES 8
+#define TRAIN_REGULARIZATION 8.0
+#define TRAIN_NUM_WEIGHTS (EVAL_NUM_PHASES * EVAL_PHASE_SIZE)
+
+// Plays games between per-thread copies of one AI and appends them to the
+// file.
+void PlayTrainingGames(const char *path, int num_games, int depth) {
+  FILE *file = fopen(path, "ab");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    exit(1);
+  }
+  AI prototype = AIMakeAlphaBeta(depth, 1);
+  AIEnableEndgameSolver(&prototype, 14, true);
+
+#pragma omp parallel
+  {
+    AI ai = AIMakeSameTypeAs(&prototype);
+    MTRand rng = systemSeedRand();
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < num_games; ++i) {
+      Board start = OpeningBoard();
+      Turn turn = BLACKS_TURN;
+      for (int m = 0; m < TRAIN_RANDOM_OPENING_MOVES; ++m) {
+        uint64_t moves = GenerateMoves(&start, turn);
+        int n = (int)genRandUniform(&rng, __builtin_popcountll(moves));
+        MakeMove(&start, turn, NthSetBit(moves, n));
+        turn = (turn == BLACKS_TURN) ? WHITES_TURN : BLACKS_TURN;
+      }
+      Game game = PlayFrom(&ai, &ai, &start, turn);
+#pragma omp critical(write_training_game)
+      GameWrite(file, &game);
+    }
+    ai.clear(&ai);
+  }
+
+  prototype.clear(&prototype);
+  fclose(file);
+}
+
+// Reads up to max_games games. Returns how many were read.
+int ReadGames(FILE *file, Game *games, int max_games) {
+  int count = 0;
+  while (count < max_games && GameRead(file, &games[count])) {
+    count++;
+  }
+  return count;
+}
+
+// Prediction of the weights, in discs, for a position.
+float p_Predict(const float *weights, const EvalState *state, int phase) {
+  const float *table = weights + phase * EVAL_PHASE_SIZE;
+  float prediction = 0.0f;
+  for (int i = 0; i < EVAL_NUM_INSTANCES; ++i) {
+    prediction +=
+        table[EVAL_PATTERN_OFFSETS[i % EVAL_NUM_PATTERNS] + state->indices[i]];
+  }
+  return prediction;
+}
+
+typedef struct TrainTotals {
+  double train_error;
+  double validation_error;
+  long train_positions;
+  long validation_positions;
+} TrainTotals;
+
+// Counts how often each weight occurs in the training positions. This does
+// not depend on the weights, so it is done once.
+void CountOccurrences(FILE *file, uint32_t *counts) {
+  Game *games = (Game *)malloc(TRAIN_CHUNK_GAMES * sizeof(Game));
+  rewind(file);
+  long first_game = 0;
+  int num_games;
+  while ((num_games = ReadGames(file, games, TRAIN_CHUNK_GAMES)) > 0) {
+    for (int g = 0; g < num_games; ++g) {
+      const Game *game = &games[g];
+      if ((first_game + g) % TRAIN_VALIDATION_EVERY == 0) {
+        continue;
+      }
+      for (int m = 0; m < game->length; ++m) {
+        const Board *board = &game->history[m];
+        EvalState state;
+        EvalStateInit(&state, board);
+        int phase =
+            EvalPhase(__builtin_popcountll(board->blacks | board->whites));
+        uint32_t *table = counts + phase * EVAL_PHASE_SIZE;
+        for (int i = 0; i < EVAL_NUM_INSTANCES; ++i) {
+          table[EVAL_PATTERN_OFFSETS[i % EVAL_NUM_PATTERNS] +
+                state.indices[i]]++;
+        }
+      }
+    }
+    first_game += num_games;
+  }
+  free(games);
+}
+
+// One pass over the file. Stores the sum of the residuals of the training
+// positions for each weight in gradient.
+TrainTotals TrainEpoch(FILE *file, const float *weights, float *gradient) {
+  int num_threads = omp_get_max_threads();
+  float *thread_gradients =
+      (float *)malloc((size_t)num_threads * TRAIN_NUM_WEIGHTS * sizeof(float));
+  memset(thread_gradients, 0,
+         (size_t)num_threads * TRAIN_NUM_WEIGHTS * sizeof(float));
+  Game *games = (Game *)malloc(TRAIN_CHUNK_GAMES * sizeof(Game));
+
+  TrainTotals totals = {0.0, 0.0, 0, 0};
+  rewind(file);
+  long first_game = 0;
+  int num_games;
+  while ((num_games = ReadGames(file, games, TRAIN_CHUNK_GAMES)) > 0) {
+    double train_error = 0.0;
+    double validation_error = 0.0;
+    long train_positions = 0;
+    long validation_positions = 0;
+#pragma omp parallel for schedule(dynamic, 16)                                 \
+    reduction(+ : train_error, validation_error, train_positions,              \
+                  validation_positions)
+    for (int g = 0; g < num_games; ++g) {
+      float *thread_gradient =
+          thread_gradients + (size_t)omp_get_thread_num() * TRAIN_NUM_WEIGHTS;
+      const Game *game = &games[g];
+      bool validation = (first_game + g) % TRAIN_VALIDATION_EVERY == 0;
+      for (int m = 0; m < game->length; ++m) {
+        const Board *board = &game->history[m];
+        EvalState state;
+        EvalStateInit(&state, board);
+        int phase =
+            EvalPhase(__builtin_popcountll(board->blacks | board->whites));
+        float residual =
+            game->disc_difference - p_Predict(weights, &state, phase);
+        if (validation) {
+          validation_error += residual * residual;
+          validation_positions++;
+          continue;
+        }
+        train_error += residual * residual;
+        train_positions++;
+        float *table = thread_gradient + phase * EVAL_PHASE_SIZE;
+        for (int i = 0; i < EVAL_NUM_INSTANCES; ++i) {
+          table[EVAL_PATTERN_OFFSETS[i % EVAL_NUM_PATTERNS] +
+                state.indices[i]] += residual;
+        }
+      }
+    }
+    totals.train_error += train_error;
+    totals.validation_error += validation_error;
+    totals.train_positions += train_positions;
+    totals.validation_positions += validation_positions;
+    first_game += num_games;
+  }
+
+#pragma omp parallel for
+  for (int w = 0; w < TRAIN_NUM_WEIGHTS; ++w) {
+    float sum = 0.0f;
+    for (int t = 0; t < num_threads; ++t) {
+      sum += thread_gradients[(size_t)t * TRAIN_NUM_WEIGHTS + w];
+    }
+    gradient[w] = sum;
+  }
+
+  free(games);
+  free(thread_gradients);
+  return totals;
+}
+
+void FitWeights(const char *games_path, const char *weights_path,
+                int num_epochs, float rate) {
+  FILE *file = fopen(games_path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", games_path);
+    exit(1);
+  }
+  float *weights = (float *)calloc(TRAIN_NUM_WEIGHTS, sizeof(float));
+  float *gradient = (float *)malloc(TRAIN_NUM_WEIGHTS * sizeof(float));
+  uint32_t *counts = (uint32_t *)calloc(TRAIN_NUM_WEIGHTS, sizeof(uint32_t));
+
+  CountOccurrences(file, counts);
+  // Every position moves EVAL_NUM_INSTANCES weights at once, so a full step
+  // per weight would overshoot by about that factor.
+  float step = rate / EVAL_NUM_INSTANCES;
+  for (int epoch = 0; epoch < num_epochs; ++epoch) {
+    double t0 = omp_get_wtime();
+    TrainTotals totals = TrainEpoch(file, weights, gradient);
+    for (int w = 0; w < TRAIN_NUM_WEIGHTS; ++w) {
+      weights[w] += step * gradient[w] / (counts[w] + TRAIN_REGULARIZATION);
+    }
+    printf("epoch %3d: train rmse %6.3f  validation rmse %6.3f  "
+           "(%ld positions, %.1fs)\n",
+           epoch, sqrt(totals.train_error / totals.train_positions),
+           sqrt(totals.validation_error / totals.validation_positions),
+           totals.train_positions, omp_get_wtime() - t0);
+  }
+  fclose(file);
+
+  EvalWeights eval_weights;
+  EvalWeightsInit(&eval_weights);
+  for (int w = 0; w < TRAIN_NUM_WEIGHTS; ++w) {
+    float scaled = roundf(weights[w] * EVAL_SCALE);
+    scaled = fminf(fmaxf(scaled, INT16_MIN), INT16_MAX);
+    eval_weights.weights[w] = (int16_t)scaled;
+  }
+  if (!EvalSaveWeights(&eval_weights, weights_path)) {
+    fprintf(stderr, "cannot write %s\n", weights_path);
+    exit(1);
+  }
+  EvalWeightsFree(&eval_weights);
+  free(counts);
+  free(gradient);
+  free(weights);
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 4 && strcmp(argv[1], "play") == 0) {
+    int depth = (argc > 4) ? atoi(argv[4]) : 4;
+    PlayTrainingGames(argv[2], atoi(argv[3]), depth);
+    return 0;
+  }
+  if (argc >= 4 && strcmp(argv[1], "fit") == 0) {
+    int num_epochs = (argc > 4) ? atoi(argv[4]) : 30;
+    float rate = (argc > 5) ? atof(argv[5]) : 1.0f;
+    FitWeights(argv[2], argv[3], num_epochs, rate);
+    return 0;
+  }
+  fprintf(stderr, "usage: %s play <games_file> <num_games> [depth]\n"
+                  "       %s fit <games_file> <weights_file> [epochs] "
+                  "[rate]\n",
+          argv[0], argv[0]);
+  return 1;
+}
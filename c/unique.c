@@ -0,0 +1,89 @@
+// Unique-position benchmark. Collects the canonical positions reachable
+// within each depth from OpeningBoard() with the serial breadth-first search
+// (up to max_serial_depth, with both BoardSet and FlatBoardSet) and the
+// parallel one at max_threads threads (with both the sharded and the
+// lock-free set), checks that the counts agree, and reports the time of
+// each.
+//
+// Usage: ./unique [max_depth] [max_threads] [max_serial_depth]
+
+#include "board.h"
+#include "explore.h"
+#include "table.h"
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <omp.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  int max_depth = (argc > 1) ? atoi(argv[1]) : 9;
+  int max_threads = (argc > 2) ? atoi(argv[2]) : omp_get_max_threads();
+  int max_serial_depth = (argc > 3) ? atoi(argv[3]) : max_depth;
+
+  bool ok = true;
+  for (int depth = 1; depth <= max_depth; ++depth) {
+    Board opening_board = OpeningBoard();
+    uint64_t serial_size = 0;
+    double serial_seconds = 0.0;
+    double flat_seconds = 0.0;
+    bool flat_same = true;
+    if (depth <= max_serial_depth) {
+      BoardSet set;
+      BoardSetInit(&set);
+      double t0 = omp_get_wtime();
+      CollectBoardSetBreadthFirst(&opening_board, BLACKS_TURN, depth, &set);
+      serial_seconds = omp_get_wtime() - t0;
+      serial_size = set.size;
+      BoardSetFree(&set);
+
+      FlatBoardSet flat;
+      FlatBoardSetInit(&flat, 12, BoardHash64);
+      t0 = omp_get_wtime();
+      CollectFlatBoardSetBreadthFirst(&opening_board, BLACKS_TURN, depth,
+                                      &flat);
+      flat_seconds = omp_get_wtime() - t0;
+      flat_same = flat.size == serial_size;
+      FlatBoardSetFree(&flat);
+    }
+
+    ShardedBoardSet *sharded =
+        (ShardedBoardSet *)malloc(sizeof(ShardedBoardSet));
+    ShardedBoardSetInit(sharded);
+    double t0 = omp_get_wtime();
+    CollectBoardSetBreadthFirstParallel(&opening_board, BLACKS_TURN, depth,
+                                        max_threads, sharded);
+    double sharded_seconds = omp_get_wtime() - t0;
+    uint64_t size = ShardedBoardSetSize(sharded);
+    ShardedBoardSetFree(sharded);
+    free(sharded);
+
+    ConcurrentBoardSet lock_free;
+    ConcurrentBoardSetInit(&lock_free, 12);
+    t0 = omp_get_wtime();
+    CollectConcurrentBoardSetBreadthFirst(&opening_board, BLACKS_TURN, depth,
+                                          max_threads, &lock_free);
+    double lock_free_seconds = omp_get_wtime() - t0;
+    bool same = ConcurrentBoardSetSize(&lock_free) == size;
+    ConcurrentBoardSetFree(&lock_free);
+
+    printf("depth %2d: %12" PRIu64 " positions  %3d threads  "
+           "sharded %9.3fs  lock-free %9.3fs",
+           depth, size, max_threads, sharded_seconds, lock_free_seconds);
+    if (depth <= max_serial_depth) {
+      same = same && size == serial_size && flat_same;
+      printf("  serial %9.3fs  flat %9.3fs", serial_seconds, flat_seconds);
+    }
+    ok = ok && same;
+    printf("  %s\n", same ? "ok" : "MISMATCH");
+  }
+
+  if (!ok) {
+    printf("\nunique FAILED\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+#ifndef REV_ZOBRIST_H_
+#define REV_ZOBRIST_H_
+
+#include "board.h"
+
+#include <stdint.h>
+
+// Zobrist hashing. A board hashes to the XOR of a random key for each disc
+// (color and square), so a move changes the hash by the keys of the disc it
+// places and the discs it flips, and a child is hashed from its parent
+// without looking at the rest of the board.
+//
+// ZobristLanes holds the hashes of all eight symmetric images of a board,
+// lane k for SymmetricBoard(board, k). A move updates each lane with the
+// keys of its own image of the move, and the hash of the canonical form of
+// a board is the lane of the symmetry MakeBoardCanonicalSymmetry() returns.
+
+#define ZOBRIST_NUM_SYMMETRIES 8
+
+// ZOBRIST_KEYS[c][i] is the key of a disc of color c (a Turn) on square i.
+uint64_t ZOBRIST_KEYS[2][64];
+// Both keys of a square XORed: flipping a disc there, either way, changes
+// the hash by this.
+uint64_t ZOBRIST_FLIP_KEYS[64];
+// The keys of square i's image under each symmetry, side by side:
+// ZOBRIST_LANE_KEYS[c][i][k] is ZOBRIST_KEYS[c][image of i under k].
+uint64_t ZOBRIST_LANE_KEYS[2][64][ZOBRIST_NUM_SYMMETRIES]
+    __attribute__((aligned(64)));
+uint64_t ZOBRIST_LANE_FLIP_KEYS[64][ZOBRIST_NUM_SYMMETRIES]
+    __attribute__((aligned(64)));
+
+typedef struct ZobristLanes {
+  uint64_t lanes[ZOBRIST_NUM_SYMMETRIES] __attribute__((aligned(64)));
+} ZobristLanes;
+
+// The keys are drawn from a fixed seed (with SplitMix64), so hashes are the
+// same on every run.
+__attribute__((constructor)) void p_InitZobristKeys() {
+  uint64_t state = 0x5EED2B0A2D5EED5;
+  for (int c = 0; c < 2; ++c) {
+    for (int i = 0; i < 64; ++i) {
+      uint64_t z = (state += 0x9E3779B97F4A7C15);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+      ZOBRIST_KEYS[c][i] = z ^ (z >> 31);
+    }
+  }
+  for (int i = 0; i < 64; ++i) {
+    ZOBRIST_FLIP_KEYS[i] = ZOBRIST_KEYS[0][i] ^ ZOBRIST_KEYS[1][i];
+  }
+  for (int i = 0; i < 64; ++i) {
+    for (int k = 0; k < ZOBRIST_NUM_SYMMETRIES; ++k) {
+      int image = __builtin_ctzll(SymmetricPieces(1ULL << i, k));
+      ZOBRIST_LANE_KEYS[0][i][k] = ZOBRIST_KEYS[0][image];
+      ZOBRIST_LANE_KEYS[1][i][k] = ZOBRIST_KEYS[1][image];
+      ZOBRIST_LANE_FLIP_KEYS[i][k] = ZOBRIST_FLIP_KEYS[image];
+    }
+  }
+}
+
+// Hashes a board from scratch.
+uint64_t ZobristHash(const Board *board) {
+  uint64_t hash = 0;
+  for (uint64_t b = board->blacks; b != 0; b = b & (b - 1)) {
+    hash ^= ZOBRIST_KEYS[BLACKS_TURN][__builtin_ctzll(b)];
+  }
+  for (uint64_t w = board->whites; w != 0; w = w & (w - 1)) {
+    hash ^= ZOBRIST_KEYS[WHITES_TURN][__builtin_ctzll(w)];
+  }
+  return hash;
+}
+
+// What ApplyMove(board, turn, square, flips) XORs into the hash of board.
+uint64_t ZobristMoveDelta(Turn turn, int square, uint64_t flips) {
+  uint64_t delta = ZOBRIST_KEYS[turn][square];
+  for (; flips != 0; flips = flips & (flips - 1)) {
+    delta ^= ZOBRIST_FLIP_KEYS[__builtin_ctzll(flips)];
+  }
+  return delta;
+}
+
+void ZobristLanesOf(const Board *board, ZobristLanes *lanes) {
+  for (int k = 0; k < ZOBRIST_NUM_SYMMETRIES; ++k) {
+    lanes->lanes[k] = 0;
+  }
+  for (int c = 0; c < 2; ++c) {
+    uint64_t pieces = (c == BLACKS_TURN) ? board->blacks : board->whites;
+    for (; pieces != 0; pieces = pieces & (pieces - 1)) {
+      const uint64_t *keys = ZOBRIST_LANE_KEYS[c][__builtin_ctzll(pieces)];
+      for (int k = 0; k < ZOBRIST_NUM_SYMMETRIES; ++k) {
+        lanes->lanes[k] ^= keys[k];
+      }
+    }
+  }
+}
+
+// ZobristMoveDelta() for every lane.
+void ZobristLanesApplyMove(ZobristLanes *lanes, Turn turn, int square,
+                           uint64_t flips) {
+  const uint64_t *keys = ZOBRIST_LANE_KEYS[turn][square];
+  for (int k = 0; k < ZOBRIST_NUM_SYMMETRIES; ++k) {
+    lanes->lanes[k] ^= keys[k];
+  }
+  for (; flips != 0; flips = flips & (flips - 1)) {
+    keys = ZOBRIST_LANE_FLIP_KEYS[__builtin_ctzll(flips)];
+    for (int k = 0; k < ZOBRIST_NUM_SYMMETRIES; ++k) {
+      lanes->lanes[k] ^= keys[k];
+    }
+  }
+}
+
+// ZobristMoveDelta() for the lane of one symmetry only.
+uint64_t ZobristLaneMoveDelta(int symmetry, Turn turn, int square,
+                              uint64_t flips) {
+  uint64_t delta = ZOBRIST_LANE_KEYS[turn][square][symmetry];
+  for (; flips != 0; flips = flips & (flips - 1)) {
+    delta ^= ZOBRIST_LANE_FLIP_KEYS[__builtin_ctzll(flips)][symmetry];
+  }
+  return delta;
+}
+
+// GenerateCanonicalChildBoards() that also writes the ZobristHash() of each
+// child to hashes. lanes must be the ZobristLanesOf() board. Each child is
+// hashed from the lane of the symmetry that canonicalizes it, so only the
+// keys of the move are looked up.
+void GenerateCanonicalChildBoardsHashed(const Board *board, Turn turn,
+                                        const ZobristLanes *lanes,
+                                        ChildBoards *children,
+                                        uint64_t *hashes) {
+  children->count = 0;
+  uint64_t moves = GenerateMoves(board, turn);
+  ChildSet siblings = {.used = 0};
+  while (moves != 0) {
+    int square = __builtin_ctzll(moves);
+    moves = moves & (moves - 1);
+
+    Board *child = &children->boards[children->count];
+    *child = *board;
+    uint64_t flips = ComputeFlips(board, turn, square);
+    ApplyMove(child, turn, square, flips);
+    int symmetry = MakeBoardCanonicalSymmetry(child);
+    if (!p_ChildSetAdd(&siblings, children->boards, children->count)) {
+      continue;
+    }
+    hashes[children->count] =
+        lanes->lanes[symmetry] ^
+        ZobristLaneMoveDelta(symmetry, turn, square, flips);
+    children->count++;
+  }
+}
+
+#endif // REV_ZOBRIST_H_